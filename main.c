@@ -0,0 +1,674 @@
+/*
+  Copyright (c) 2013, Ilan Schnell, Continuum Analytics, Inc.
+  Command line front end to picosat, which solves DIMACS files without
+  going through Python.  This file is published under the same license
+  as picosat itself, which uses an MIT style license.
+*/
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "picosat.h"
+
+static const char *usage =
+"usage: picosat [options] [file.cnf | -]\n"
+"       picosat --bench <dir> [options]\n"
+"\n"
+"  -h             print this help and exit\n"
+"  -v             increase verbosity of the solver\n"
+"  -n             do not print the solution\n"
+"  -s <seed>      seed of the random number generator\n"
+"  -t <seconds>   time limit\n"
+"  -c <number>    conflict limit\n"
+"  -p <number>    propagation limit\n"
+"  -m <mbytes>    memory limit\n"
+"  -j <file>      write statistics as JSON to <file> ('-' for stdout)\n"
+"  -r <file>      write a RUP proof of unsatisfiability to <file>\n"
+"  --bench <dir>  solve all files of <dir> and summarize the throughput\n"
+"\n"
+"The exit code is 10 if the clauses are satisfiable, 20 if they are\n"
+"unsatisfiable and 0 if a limit was reached.\n";
+
+typedef struct limits {
+  double seconds;               /* 0 for no limit */
+  unsigned long long conflicts; /* 0 for no limit */
+  unsigned long long propagations; /* 0 for no limit */
+  size_t bytes;                 /* 0 for no limit */
+} limits;
+
+typedef struct run {
+  const char *path;
+  int res;                      /* -1 on parse errors */
+  int variables, clauses;
+  double parse_seconds, solve_seconds;
+  unsigned long long decisions, conflicts, propagations;
+  size_t max_bytes;
+} run;
+
+typedef struct interrupt {
+  PicoSAT *picosat;
+  const limits *lim;
+  double start;
+} interrupt;
+
+static volatile sig_atomic_t caught_signal = 0;
+
+static void
+catch_signal (int sig)
+{
+  caught_signal = sig;
+}
+
+static int
+interrupted (void *state)
+{
+  interrupt *it = state;
+  const limits *lim = it->lim;
+
+  if (caught_signal)
+    return 1;
+  if (lim->seconds > 0 && picosat_time_stamp () - it->start >= lim->seconds)
+    return 1;
+  if (lim->conflicts && picosat_conflicts (it->picosat) >= lim->conflicts)
+    return 1;
+  if (lim->bytes && picosat_max_bytes_allocated (it->picosat) >= lim->bytes)
+    return 1;
+  return 0;
+}
+
+static void
+die (const char *fmt, ...)
+{
+  va_list ap;
+
+  fputs ("*** picosat: ", stderr);
+  va_start (ap, fmt);
+  vfprintf (stderr, fmt, ap);
+  va_end (ap);
+  fputc ('\n', stderr);
+  exit (1);
+}
+
+/*------------------------------------------------------------------------*/
+/* The whole file is read into memory, and the integers are scanned in
+ * place, which is much faster than 'fscanf' or 'getc' on large files.
+ */
+
+static char *
+read_file (const char *path, size_t *len)
+{
+  FILE *file;
+  char *buf, *tmp;
+  size_t size = 1 << 16, n = 0, k;
+
+  if (strcmp (path, "-") == 0)
+    file = stdin;
+  else if (!(file = fopen (path, "rb")))
+    return NULL;
+
+  buf = malloc (size + 1);
+  while (buf)
+    {
+      k = fread (buf + n, 1, size - n, file);
+      n += k;
+      if (n < size)
+        break;
+      size *= 2;
+      if (!(tmp = realloc (buf, size + 1)))
+        free (buf);
+      buf = tmp;
+    }
+  if (buf && ferror (file))
+    {
+      free (buf);
+      buf = NULL;
+    }
+  if (file != stdin)
+    fclose (file);
+  if (!buf)
+    return NULL;
+
+  buf[n] = '\0';
+  *len = n;
+  return buf;
+}
+
+/* Add the clauses of the DIMACS text 'p' to 'picosat'.  Returns an error
+ * message (and the line in 'lineno') or NULL.
+ */
+static const char *
+parse (PicoSAT *picosat, FILE *rup, char *p, run *r, int *lineno)
+{
+  int *clause = NULL, *tmp, size = 0, n = 0, count = 0, header = 0;
+  int lit, sign, max_idx = 0, nclauses = 0;
+  const char *err = NULL;
+  unsigned long long v;
+
+  *lineno = 1;
+  for (;;)
+    {
+      while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        if (*p++ == '\n')
+          ++*lineno;
+
+      if (!*p)
+        break;
+
+      if (*p == 'c')
+        {
+          while (*p && *p != '\n')
+            p++;
+          continue;
+        }
+
+      if (*p == '%' && header)          /* end of SATLIB files */
+        break;
+
+      if (*p == 'p')
+        {
+          if (header)
+            {
+              err = "second header";
+              goto done;
+            }
+          if (sscanf (p, "p cnf %d %d", &max_idx, &nclauses) != 2 ||
+              max_idx < 0 || nclauses < 0)
+            {
+              err = "invalid header";
+              goto done;
+            }
+          while (*p && *p != '\n')
+            p++;
+          header = 1;
+          picosat_adjust (picosat, max_idx);
+          if (rup)
+            picosat_set_incremental_rup_file (picosat, rup,
+                                              max_idx, nclauses);
+          continue;
+        }
+
+      if (!header)
+        {
+          err = "missing header";
+          goto done;
+        }
+
+      sign = 1;
+      if (*p == '-')
+        {
+          sign = -1;
+          p++;
+        }
+      if (!isdigit ((unsigned char) *p))
+        {
+          err = "expected literal";
+          goto done;
+        }
+      v = 0;
+      while (isdigit ((unsigned char) *p))
+        {
+          v = 10 * v + (unsigned) (*p++ - '0');
+          if (v > (unsigned long long) max_idx)
+            {
+              err = "literal exceeds maximal variable index of header";
+              goto done;
+            }
+        }
+      if (v == 0 && sign < 0)
+        {
+          err = "expected literal";
+          goto done;
+        }
+      lit = sign * (int) v;
+
+      if (n == size)
+        {
+          size = size ? 2 * size : 64;
+          if (!(tmp = realloc (clause, size * sizeof *clause)))
+            {
+              err = "out of memory";
+              goto done;
+            }
+          clause = tmp;
+        }
+      clause[n++] = lit;
+
+      if (!lit)
+        {
+          if (count++ == nclauses)
+            {
+              err = "too many clauses";
+              goto done;
+            }
+          picosat_add_lits (picosat, clause);
+          n = 0;
+        }
+    }
+
+  if (!header)
+    err = "missing header";
+  else if (n)
+    err = "trailing zero missing";
+  else if (count < nclauses)
+    err = "clauses missing";
+
+done:
+  free (clause);
+  r->variables = max_idx;
+  r->clauses = count;
+  return err;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+print_solution (PicoSAT *picosat, FILE *out)
+{
+  int i, max_idx = picosat_variables (picosat), len = 1, k;
+  char buf[16];
+
+  fputs ("v", out);
+  for (i = 1; i <= max_idx; i++)
+    {
+      k = sprintf (buf, " %d", picosat_deref (picosat, i) > 0 ? i : -i);
+      if (len + k > 78)
+        {
+          fputs ("\nv", out);
+          len = 1;
+        }
+      fputs (buf, out);
+      len += k;
+    }
+  fputs (len + 2 > 78 ? "\nv 0\n" : " 0\n", out);
+}
+
+static const char *
+result_name (int res)
+{
+  switch (res)
+    {
+    case PICOSAT_SATISFIABLE:
+      return "SATISFIABLE";
+    case PICOSAT_UNSATISFIABLE:
+      return "UNSATISFIABLE";
+    case PICOSAT_UNKNOWN:
+      return "UNKNOWN";
+    default:
+      return "ERROR";
+    }
+}
+
+/* Parse and solve the file 'path' within the limits 'lim'.
+ */
+static void
+solve_file (const char *path, const limits *lim, int verbosity, int seed,
+            int print, FILE *rup, run *r)
+{
+  PicoSAT *picosat;
+  interrupt it;
+  const char *err;
+  char *text;
+  size_t len;
+  double start;
+  int lineno;
+
+  memset (r, 0, sizeof *r);
+  r->path = path;
+  r->res = -1;
+
+  start = picosat_time_stamp ();
+  if (!(text = read_file (path, &len)))
+    {
+      fprintf (stderr, "*** picosat: can not read '%s': %s\n",
+               path, strerror (errno));
+      return;
+    }
+
+  picosat = picosat_init ();
+  picosat_set_verbosity (picosat, verbosity);
+  picosat_set_prefix (picosat, "c ");
+  if (seed >= 0)
+    picosat_set_seed (picosat, (unsigned) seed);
+
+  err = parse (picosat, rup, text, r, &lineno);
+  free (text);
+  r->parse_seconds = picosat_time_stamp () - start;
+  if (err)
+    {
+      fprintf (stderr, "*** picosat: %s:%d: %s\n", path, lineno, err);
+      picosat_reset (picosat);
+      return;
+    }
+
+  if (lim->propagations)
+    picosat_set_propagation_limit (picosat, lim->propagations);
+  it.picosat = picosat;
+  it.lim = lim;
+  it.start = start;
+  picosat_set_interrupt (picosat, &it, interrupted);
+
+  r->res = picosat_sat (picosat, -1);
+  r->solve_seconds = picosat_seconds (picosat);
+  r->decisions = picosat_decisions (picosat);
+  r->conflicts = picosat_conflicts (picosat);
+  r->propagations = picosat_propagations (picosat);
+  r->max_bytes = picosat_max_bytes_allocated (picosat);
+
+  if (print)
+    {
+      printf ("s %s\n", result_name (r->res));
+      if (print > 1 && r->res == PICOSAT_SATISFIABLE)
+        print_solution (picosat, stdout);
+      fflush (stdout);
+    }
+  if (verbosity)
+    picosat_stats (picosat);
+  picosat_reset (picosat);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+json_string (FILE *out, const char *s)
+{
+  fputc ('"', out);
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        fprintf (out, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+        fprintf (out, "\\u%04x", (unsigned char) *s);
+      else
+        fputc (*s, out);
+    }
+  fputc ('"', out);
+}
+
+static double
+per_second (unsigned long long n, double seconds)
+{
+  return seconds > 0 ? n / seconds : 0;
+}
+
+static void
+json_run (FILE *out, const run *r, const char *indent)
+{
+  fprintf (out, "%s{", indent);
+  if (r->path)                          /* not for the totals */
+    {
+      fputs ("\"file\": ", out);
+      json_string (out, r->path);
+      fprintf (out, ", \"result\": \"%s\",\n%s ",
+               result_name (r->res), indent);
+    }
+  fprintf (out, "\"variables\": %d, \"clauses\": %d,\n",
+           r->variables, r->clauses);
+  fprintf (out, "%s \"parse_seconds\": %.6f, \"solve_seconds\": %.6f,\n",
+           indent, r->parse_seconds, r->solve_seconds);
+  fprintf (out, "%s \"decisions\": %llu, \"conflicts\": %llu, "
+           "\"propagations\": %llu,\n",
+           indent, r->decisions, r->conflicts, r->propagations);
+  fprintf (out, "%s \"propagations_per_second\": %.0f, "
+           "\"max_bytes\": %lu}",
+           indent, per_second (r->propagations, r->solve_seconds),
+           (unsigned long) r->max_bytes);
+}
+
+static FILE *
+open_output (const char *path)
+{
+  FILE *file;
+
+  if (!path || strcmp (path, "-") == 0)
+    return stdout;
+  if (!(file = fopen (path, "w")))
+    die ("can not write '%s': %s", path, strerror (errno));
+  return file;
+}
+
+static void
+close_output (FILE *file)
+{
+  if (file == stdout)
+    fflush (file);
+  else if (fclose (file))
+    die ("write error: %s", strerror (errno));
+}
+
+static int
+compare_names (const void *a, const void *b)
+{
+  return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+/* Solve the regular files of 'dir' in the order of their names, print one
+ * line for each, and the totals of all files at the end.
+ */
+static void
+bench (const char *dir, const limits *lim, int seed, const char *json)
+{
+  DIR *d;
+  struct dirent *de;
+  struct stat st;
+  char **paths = NULL, **tmp, *path;
+  size_t n = 0, size = 0, i, len;
+  run *runs, total;
+  int counts[4] = {0, 0, 0, 0};     /* sat, unsat, unknown, error */
+  FILE *out;
+
+  if (!(d = opendir (dir)))
+    die ("can not open directory '%s': %s", dir, strerror (errno));
+  while ((de = readdir (d)))
+    {
+      if (de->d_name[0] == '.')
+        continue;
+      len = strlen (dir) + strlen (de->d_name) + 2;
+      if (!(path = malloc (len)))
+        die ("out of memory");
+      sprintf (path, "%s/%s", dir, de->d_name);
+      if (stat (path, &st) || !S_ISREG (st.st_mode))
+        {
+          free (path);
+          continue;
+        }
+      if (n == size)
+        {
+          size = size ? 2 * size : 64;
+          if (!(tmp = realloc (paths, size * sizeof *paths)))
+            die ("out of memory");
+          paths = tmp;
+        }
+      paths[n++] = path;
+    }
+  closedir (d);
+  if (!n)
+    die ("no files in '%s'", dir);
+  qsort (paths, n, sizeof *paths, compare_names);
+
+  if (!(runs = calloc (n, sizeof *runs)))
+    die ("out of memory");
+  memset (&total, 0, sizeof total);
+
+  printf ("%-40s %-13s %10s %10s %14s\n",
+          "file", "result", "parse", "solve", "props/sec");
+  for (i = 0; i < n && !caught_signal; i++)
+    {
+      run *r = runs + i;
+
+      solve_file (paths[i], lim, 0, seed, 0, NULL, r);
+      counts[r->res == PICOSAT_SATISFIABLE ? 0 :
+             r->res == PICOSAT_UNSATISFIABLE ? 1 :
+             r->res == PICOSAT_UNKNOWN ? 2 : 3]++;
+      total.variables += r->variables;
+      total.clauses += r->clauses;
+      total.parse_seconds += r->parse_seconds;
+      total.solve_seconds += r->solve_seconds;
+      total.decisions += r->decisions;
+      total.conflicts += r->conflicts;
+      total.propagations += r->propagations;
+      if (r->max_bytes > total.max_bytes)
+        total.max_bytes = r->max_bytes;
+
+      printf ("%-40s %-13s %10.3f %10.3f %14.0f\n",
+              strrchr (r->path, '/') + 1, result_name (r->res),
+              r->parse_seconds, r->solve_seconds,
+              per_second (r->propagations, r->solve_seconds));
+      fflush (stdout);
+    }
+
+  printf ("\n%lu files: %d satisfiable, %d unsatisfiable, "
+          "%d unknown, %d errors\n",
+          (unsigned long) i, counts[0], counts[1], counts[2], counts[3]);
+  printf ("%.3f seconds parsing, %.3f seconds solving, "
+          "%.1f files/sec\n", total.parse_seconds, total.solve_seconds,
+          per_second (i, total.parse_seconds + total.solve_seconds));
+  printf ("%llu propagations, %.0f propagations/sec, "
+          "%.0f conflicts/sec\n", total.propagations,
+          per_second (total.propagations, total.solve_seconds),
+          per_second (total.conflicts, total.solve_seconds));
+
+  if (json)
+    {
+      size_t k;
+
+      out = open_output (json);
+      fputs ("{\"files\": [\n", out);
+      for (k = 0; k < i; k++)
+        {
+          json_run (out, runs + k, "  ");
+          fputs (k + 1 < i ? ",\n" : "\n", out);
+        }
+      fprintf (out, "],\n \"satisfiable\": %d, \"unsatisfiable\": %d, "
+               "\"unknown\": %d, \"errors\": %d,\n \"total\":\n",
+               counts[0], counts[1], counts[2], counts[3]);
+      json_run (out, &total, "  ");
+      fputs ("}\n", out);
+      close_output (out);
+    }
+
+  for (i = 0; i < n; i++)
+    free (paths[i]);
+  free (paths);
+  free (runs);
+}
+
+/*------------------------------------------------------------------------*/
+
+static unsigned long long
+parse_number (const char *opt, const char *arg)
+{
+  unsigned long long res;
+  char *end;
+
+  if (!arg)
+    die ("argument to '%s' missing", opt);
+  errno = 0;
+  res = strtoull (arg, &end, 10);
+  if (errno || end == arg || *end || *arg == '-')
+    die ("invalid argument '%s' to '%s'", arg, opt);
+  return res;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *path = NULL, *json = NULL, *proof = NULL, *dir = NULL;
+  int i, verbosity = 0, print = 2, seed = -1;
+  limits lim;
+  FILE *rup = NULL, *out;
+  run r;
+
+  memset (&lim, 0, sizeof lim);
+  for (i = 1; i < argc; i++)
+    {
+      const char *opt = argv[i], *arg = argv[i + 1];
+
+      if (!strcmp (opt, "-h") || !strcmp (opt, "--help"))
+        {
+          fputs (usage, stdout);
+          return 0;
+        }
+      else if (!strcmp (opt, "-v"))
+        verbosity++;
+      else if (!strcmp (opt, "-n"))
+        print = 1;
+      else if (!strcmp (opt, "-s"))
+        seed = (int) (parse_number (opt, arg) % INT_MAX), i++;
+      else if (!strcmp (opt, "-t"))
+        {
+          char *end;
+
+          if (!arg || (lim.seconds = strtod (arg, &end)) <= 0 || *end)
+            die ("invalid argument to '-t'");
+          i++;
+        }
+      else if (!strcmp (opt, "-c"))
+        lim.conflicts = parse_number (opt, arg), i++;
+      else if (!strcmp (opt, "-p"))
+        lim.propagations = parse_number (opt, arg), i++;
+      else if (!strcmp (opt, "-m"))
+        lim.bytes = (size_t) parse_number (opt, arg) << 20, i++;
+      else if (!strcmp (opt, "-j"))
+        {
+          if (!(json = arg))
+            die ("argument to '-j' missing");
+          i++;
+        }
+      else if (!strcmp (opt, "-r"))
+        {
+          if (!(proof = arg))
+            die ("argument to '-r' missing");
+          i++;
+        }
+      else if (!strcmp (opt, "--bench"))
+        {
+          if (!(dir = arg))
+            die ("argument to '--bench' missing");
+          i++;
+        }
+      else if (opt[0] == '-' && opt[1])
+        die ("invalid option '%s' (try '-h')", opt);
+      else if (path)
+        die ("multiple input files '%s' and '%s'", path, opt);
+      else
+        path = opt;
+    }
+
+  signal (SIGINT, catch_signal);
+  signal (SIGTERM, catch_signal);
+
+  if (dir)
+    {
+      if (path || proof)
+        die ("'--bench' can not be combined with an input or proof file");
+      bench (dir, &lim, seed, json);
+      return caught_signal ? 1 : 0;
+    }
+
+  if (proof)
+    rup = open_output (proof);
+
+  solve_file (path ? path : "-", &lim, verbosity, seed, print, rup, &r);
+
+  if (rup)
+    close_output (rup);
+  if (r.res < 0)
+    return 1;
+
+  if (json)
+    {
+      out = open_output (json);
+      json_run (out, &r, "");
+      fputc ('\n', out);
+      close_output (out);
+    }
+  return r.res;
+}
@@ -21,6 +21,7 @@ IN THE SOFTWARE.
 ****************************************************************************/
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -45,7 +46,9 @@ IN THE SOFTWARE.
 #define NDSC
  */
 
-/* Do not use luby restart schedule instead of inner/outer.
+/* Do not use luby restart schedule instead of inner/outer by default.  Both
+ * schedules are always compiled in and can be selected with the 'luby'
+ * option at run time.
  *
 #define NLUBY
  */
@@ -73,6 +76,82 @@ IN THE SOFTWARE.
 #define MAXCILS         10      /* maximal number of unrecycled internals */
 #define FFLIPPED        10000   /* flipped reduce factor */
 #define FFLIPPEDPREC    10000000/* flipped reduce factor precision */
+#define INPBUDGET       100     /* initial inprocessing budget per mille */
+#define INPMINBUDGET    10      /* minimal inprocessing budget per mille */
+#define INPMAXBUDGET    300     /* maximal inprocessing budget per mille */
+#define INTERRUPTLIM    256     /* decisions between interrupt checks */
+
+#ifdef NFL
+#define PROBE           0       /* failed literal probing compiled out */
+#else
+#define PROBE           1
+#endif
+
+#ifdef NDSC
+#define DSC             0       /* detaching satisfied clauses compiled out */
+#else
+#define DSC             1
+#endif
+
+#ifdef NLUBY
+#define LUBY            0       /* inner/outer restart schedule */
+#else
+#define LUBY            1       /* luby restart schedule */
+#endif
+
+/* The search for a replacement watch in long clauses gathers the values of
+ * eight literals at a time with AVX2, if the processor supports it (which
+ * is checked at run time).  It can be compiled out by defining 'NSIMD'.
+ */
+#if !defined(NSIMD) && defined(__x86_64__) && \
+    (defined(__clang__) || __GNUC__ >= 5)
+#include <immintrin.h>
+#define SIMD            1
+#define SIMDSIZE        32      /* minimal clause size for the vector search */
+#define LITPAD          3       /* gathers read 4 bytes for each literal */
+#else
+#define SIMD            0       /* vector search compiled out */
+#define LITPAD          0
+#endif
+
+#ifdef STATS
+#define COUNTSTATS      1       /* detailed statistics compiled in */
+#else
+#define COUNTSTATS      0
+#endif
+
+/* The hot functions 'propl', 'prop2' and 'analyze' are instantiated for
+ * each combination of the features, which can be switched at run time (see
+ * 'select_kernels'), and need to be inlined into each of them.
+ */
+#if defined(__GNUC__)
+#define ALWAYS_INLINE   inline __attribute__ ((always_inline))
+#elif defined(_MSC_VER)
+#define ALWAYS_INLINE   __forceinline
+#else
+#define ALWAYS_INLINE   inline
+#endif
+
+/* Run time options as 'OPTION (name, default, minimum, maximum, description)'.
+ * The maximum of 'probe' and 'dsc' is zero if the technique is compiled out.
+ */
+#define OPTIONS \
+OPTION (probe,      PROBE,      0, PROBE,   "failed literal probing") \
+OPTION (dsc,        DSC,        0, DSC,     "detach satisfied clauses") \
+OPTION (luby,       LUBY,       0, 1,       "luby instead of inner/outer restarts") \
+OPTION (lubyunit,   100,        1, 100000,  "conflicts per luby restart unit") \
+OPTION (minrestart, MINRESTART, 1, MAXRESTART, "minimum inner/outer restart interval") \
+OPTION (maxrestart, MAXRESTART, 1, MAXRESTART, "maximum inner/outer restart interval") \
+OPTION (frestart,   FRESTART,   101, 1000,  "restart increase factor in percent") \
+OPTION (reusetrail, 1,          0, 1,       "reuse trail on restarts") \
+OPTION (initreduce, 1000,       100, INT_MAX, "initial reduction limit") \
+OPTION (freduce,    FREDUCE,    101, 1000,  "reduce increase factor in percent") \
+OPTION (fredadj,    FREDADJ,    101, 1000,  "reduce increase adjustment factor") \
+OPTION (reduce,     50,         1, 100,     "percentage of learned clauses reduced") \
+OPTION (glue,       1,          0, 1,       "update glue of clauses in analysis") \
+OPTION (rdecide,    RDECIDE,    0, INT_MAX, "interval of random decisions (0=none)") \
+OPTION (simd,       SIMD,       0, SIMD,    "vector search in long clauses") \
+OPTION (stats,      COUNTSTATS, 0, COUNTSTATS, "detailed statistics in propagation") \
 
 #ifndef TRACE
 #define NO_BINARY_CLAUSES       /* store binary clauses more compactly */
@@ -363,7 +442,9 @@ typedef unsigned Flt;           /* 32 bit deterministic soft float */
 typedef Flt Act;                /* clause and variable activity */
 typedef struct Blk Blk;         /* allocated memory block */
 typedef struct Cls Cls;         /* clause */
+typedef struct Inp Inp;         /* inprocessing schedule */
 typedef struct Lit Lit;         /* literal */
+typedef struct Opts Opts;       /* run time options */
 typedef struct Rnk Rnk;         /* variable to score mapping */
 typedef signed char Val;        /* TRUE, UNDEF, FALSE */
 typedef struct Var Var;         /* variable */
@@ -405,8 +486,10 @@ struct Var
   unsigned humuspos     : 1;    /*bit 12*/
   unsigned humusneg     : 1;    /*bit 13*/
   unsigned partial      : 1;    /*bit 14*/
+  unsigned group        : 1;    /*bit 15*/
+  unsigned disabled     : 1;    /*bit 16*/
 #ifdef TRACE
-  unsigned core         : 1;    /*bit 15*/
+  unsigned core         : 1;    /*bit 17*/
 #endif
   unsigned level;
   Cls *reason;
@@ -423,6 +506,7 @@ struct Rnk
   unsigned pos : 30;                    /* 0 iff not on heap */
   unsigned moreimportant : 1;
   unsigned lessimportant : 1;
+  int priority;                         /* higher is decided first */
 };
 
 struct Cls
@@ -479,6 +563,29 @@ struct Blk
   char data[BLK_FILL_BYTES];
 };
 
+/* Each inprocessing technique gets an effort budget in per mille of the
+ * propagations spent in search.  Its effort is measured in 'ticks', which
+ * are propagations for probing and visited literals for collecting
+ * satisfied clauses.  After every round the budget is adapted to the
+ * effectiveness of the technique, i.e. the number of units found or clauses
+ * removed per tick.
+ */
+struct Inp
+{
+  const char * name;
+  unsigned calls;
+  unsigned budget;              /* per mille of search propagations */
+  unsigned long long ticks;     /* effort spent in all rounds */
+  unsigned long long removed;   /* units found or clauses removed */
+};
+
+struct Opts
+{
+#define OPTION(NAME,DEFAULT,MIN,MAX,DESCRIPTION) int NAME;
+  OPTIONS
+#undef OPTION
+};
+
 enum State
 {
   RESET = 0,
@@ -501,6 +608,7 @@ struct PicoSAT
   enum State state;
   enum Phase defaultphase;
   int last_sat_call_result;
+  Opts opts;
 
   FILE *out;
   char * prefix;
@@ -533,7 +641,11 @@ struct PicoSAT
   Lit **CLS, **clshead, **eocls;
   int *rils, *rilshead, *eorils;
   int *cils, *cilshead, *eocils;
+  int *grps, *grpshead, *eogrps;        /* live clause groups */
+  int group;                            /* group of added clauses */
   int *fals, *falshead, *eofals;
+  int *plits, *plitshead, *eoplits;     /* see 'picosat_propagated' */
+  int *dlits, *dlitshead, *eodlits;     /* see 'picosat_decision_lits' */
   int *mass, szmass;
   int *mssass, szmssass;
   int *mcsass, nmcsass, szmcsass;
@@ -586,6 +698,10 @@ struct PicoSAT
   unsigned calls;
   unsigned decisions;
   unsigned restarts;
+  unsigned reusedtrails;        /* restarts which kept some decisions */
+  unsigned keptassumptions;     /* calls which kept assumption decisions */
+  unsigned long long keptlevels;        /* assumption levels kept */
+  unsigned long long reusedlevels;      /* decision levels kept */
   unsigned simps;
   unsigned fsimplify;
   unsigned isimplify;
@@ -596,17 +712,25 @@ struct PicoSAT
   unsigned lastreduceconflicts;
   unsigned llocked;     /* locked large learned clauses */
   unsigned lrestart;
-#ifdef NLUBY
   unsigned drestart;
   unsigned ddrestart;
-#else
   unsigned lubycnt;
   unsigned lubymaxdelta;
   int waslubymaxdelta;
-#endif
   unsigned long long lsimplify;
+  Inp collecting;
   unsigned long long propagations;
   unsigned long long lpropagations;
+  struct {
+    void * state;
+    int (*function) (void *);
+  } interrupt;
+#if SIMD
+  int avx2;                     /* processor supports AVX2 */
+#endif
+  void (*propl) (PicoSAT *, Lit *);     /* see 'select_kernels' */
+  void (*prop2) (PicoSAT *, Lit *);
+  void (*analyze) (PicoSAT *);
   unsigned fixed;               /* top level assignments */
 #ifndef NFL
   unsigned failedlits;
@@ -619,12 +743,14 @@ struct PicoSAT
   unsigned long long floopsed, fltried, flskipped;
 #endif
   unsigned long long fllimit;
+  Inp probing;
   int simplifying;
   Lit ** saved;
   unsigned saved_size;
 #endif
   unsigned conflicts;
   unsigned contexts;
+  unsigned groups;
   unsigned internals;
   unsigned noclauses;   /* current number large original clauses */
   unsigned nlclauses;   /* current number large learned clauses */
@@ -665,6 +791,7 @@ struct PicoSAT
 #endif
   unsigned minimizedllits;
   unsigned nonminimizedllits;
+  unsigned long long gluepromotions;    /* learned clauses with smaller glue */
 #ifndef NADC
   Lit *** ados, *** hados, *** eados;
   Lit *** adotab;
@@ -703,6 +830,8 @@ struct PicoSAT
 
 typedef PicoSAT PS;
 
+static void select_kernels (PS *);
+
 static Flt
 packflt (unsigned m, int e)
 {
@@ -1180,7 +1309,7 @@ init (void * pmgr,
 #endif
   ps->min_flipped = UINT_MAX;
 
-  NEWN (ps->lits, 2 * ps->size_vars);
+  NEWN (ps->lits, 2 * ps->size_vars + LITPAD);
   NEWN (ps->jwh, 2 * ps->size_vars);
   NEWN (ps->htps, 2 * ps->size_vars);
 #ifndef NDSC
@@ -1212,6 +1341,22 @@ init (void * pmgr,
   ps->lreduceadjustcnt = ps->lreduceadjustinc = 100;
   ps->lpropagations = ~0ull;
 
+#define OPTION(NAME,DEFAULT,MIN,MAX,DESCRIPTION) ps->opts.NAME = DEFAULT;
+  OPTIONS
+#undef OPTION
+#if SIMD
+  __builtin_cpu_init ();
+  ps->avx2 = __builtin_cpu_supports ("avx2");
+#endif
+  select_kernels (ps);
+
+  ps->collecting.name = "collecting";
+  ps->collecting.budget = INPBUDGET;
+#ifndef NFL
+  ps->probing.name = "probing";
+  ps->probing.budget = INPBUDGET;
+#endif
+
   ps->out = stdout;
   new_prefix (ps, "c ");
   ps->verbosity = 0;
@@ -1474,7 +1619,7 @@ reset (PS * ps)
   DELETEN (ps->dhtps, 2 * ps->size_vars);
 #endif
   DELETEN (ps->impls, 2 * ps->size_vars);
-  DELETEN (ps->lits, 2 * ps->size_vars);
+  DELETEN (ps->lits, 2 * ps->size_vars + LITPAD);
   DELETEN (ps->jwh, 2 * ps->size_vars);
   DELETEN (ps->vars, ps->size_vars);
   DELETEN (ps->rnks, ps->size_vars);
@@ -1499,8 +1644,15 @@ reset (PS * ps)
   ps->rils = ps->eorils = ps->rilshead = 0;
   DELETEN (ps->cils, ps->eocils - ps->cils);
   ps->cils = ps->eocils = ps->cilshead = 0;
+  DELETEN (ps->grps, ps->eogrps - ps->grps);
+  ps->grps = ps->eogrps = ps->grpshead = 0;
+  ps->group = 0;
   DELETEN (ps->fals, ps->eofals - ps->fals);
   ps->fals = ps->eofals = ps->falshead = 0;
+  DELETEN (ps->plits, ps->eoplits - ps->plits);
+  ps->plits = ps->eoplits = ps->plitshead = 0;
+  DELETEN (ps->dlits, ps->eodlits - ps->dlits);
+  ps->dlits = ps->eodlits = ps->dlitshead = 0;
   DELETEN (ps->mass, ps->szmass);
   ps->szmass = 0;
   ps->mass = 0;
@@ -1579,6 +1731,10 @@ reset (PS * ps)
   ps->calls = 0;
   ps->decisions = 0;
   ps->restarts = 0;
+  ps->reusedtrails = 0;
+  ps->reusedlevels = 0;
+  ps->keptassumptions = 0;
+  ps->keptlevels = 0;
   ps->simps = 0;
   ps->iterations = 0;
   ps->reports = 0;
@@ -1597,6 +1753,7 @@ reset (PS * ps)
 #endif
   ps->propagations = 0;
   ps->contexts = 0;
+  ps->groups = 0;
   ps->internals = 0;
   ps->conflicts = 0;
   ps->noclauses = 0;
@@ -1649,6 +1806,7 @@ reset (PS * ps)
 #endif
   ps->minimizedllits = 0;
   ps->nonminimizedllits = 0;
+  ps->gluepromotions = 0;
   ps->state = RESET;
   ps->srng = 0;
 
@@ -1895,6 +2053,12 @@ cmp_rnk (Rnk * r, Rnk * s)
   if (r->lessimportant && !s->lessimportant)
     return -1;
 
+  if (r->priority < s->priority)
+    return -1;
+
+  if (r->priority > s->priority)
+    return 1;
+
   if (r->score < s->score)
     return -1;
 
@@ -2418,12 +2582,64 @@ write_rup_header (PS * ps, FILE * file)
   fflush (file);
 }
 
+/* The glue (or LBD) of a clause is the number of different decision levels
+ * of its assigned literals, where each unassigned literal counts as a level
+ * of its own.
+ */
+static unsigned
+glue_of_lits (PS * ps, Lit ** start, Lit ** end)
+{
+  unsigned litlevel, glue;
+  Lit ** p, * lit;
+
+  assert (ps->dusedhead == ps->dused);
+
+  glue = 0;
+  for (p = start; p < end; p++)
+    {
+      lit = *p;
+      if (lit->val)
+        {
+          litlevel = LIT2VAR (lit)->level;
+          assert (litlevel <= ps->LEVEL);
+          while (ps->levels + litlevel >= ps->levelshead)
+            {
+              if (ps->levelshead >= ps->eolevels)
+                ENLARGE (ps->levels, ps->levelshead, ps->eolevels);
+              assert (ps->levelshead < ps->eolevels);
+              *ps->levelshead++ = 0;
+            }
+          if (!ps->levels[litlevel])
+            {
+              if (ps->dusedhead >= ps->eodused)
+                ENLARGE (ps->dused, ps->dusedhead, ps->eodused);
+              assert (ps->dusedhead < ps->eodused);
+              *ps->dusedhead++ = litlevel;
+              ps->levels[litlevel] = 1;
+              glue++;
+            }
+        }
+      else
+        glue++;
+    }
+
+  while (ps->dusedhead > ps->dused)
+    {
+      litlevel = *--ps->dusedhead;
+      assert (ps->levels + litlevel < ps->levelshead);
+      assert (ps->levels[litlevel]);
+      ps->levels[litlevel] = 0;
+    }
+
+  return glue;
+}
+
 static Cls *
 add_simplified_clause (PS * ps, int learned)
 {
   unsigned num_true, num_undef, num_false, size, count_resolved;
   Lit **p, **q, *lit, ** end;
-  unsigned litlevel, glue;
+  unsigned glue;
   Cls *res, * reason;
   int reentered;
   Val val;
@@ -2515,49 +2731,7 @@ REENTER:
 
       res = new_clause (ps, size, learned);
 
-      glue = 0;
-
-      if (learned)
-        {
-          assert (ps->dusedhead == ps->dused);
-
-          for (p = ps->added; p < ps->ahead; p++)
-            {
-              lit = *p;
-              if (lit->val)
-                {
-                  litlevel = LIT2VAR (lit)->level;
-                  assert (litlevel <= ps->LEVEL);
-                  while (ps->levels + litlevel >= ps->levelshead)
-                    {
-                      if (ps->levelshead >= ps->eolevels)
-                        ENLARGE (ps->levels, ps->levelshead, ps->eolevels);
-                      assert (ps->levelshead < ps->eolevels);
-                      *ps->levelshead++ = 0;
-                    }
-                  if (!ps->levels[litlevel])
-                    {
-                      if (ps->dusedhead >= ps->eodused)
-                        ENLARGE (ps->dused, ps->dusedhead, ps->eodused);
-                      assert (ps->dusedhead < ps->eodused);
-                      *ps->dusedhead++ = litlevel;
-                      ps->levels[litlevel] = 1;
-                      glue++;
-                    }
-                }
-              else
-                glue++;
-            }
-
-          while (ps->dusedhead > ps->dused)
-            {
-              litlevel = *--ps->dusedhead;
-              assert (ps->levels + litlevel < ps->levelshead);
-              assert (ps->levels[litlevel]);
-              ps->levels[litlevel] = 0;
-            }
-        }
-
+      glue = learned ? glue_of_lits (ps, ps->added, ps->ahead) : 0;
       assert (glue <= MAXGLUE);
       res->glue = glue;
 
@@ -2779,6 +2953,9 @@ simplify_and_add_original_clause (PS * ps)
       if (ps->CLS != ps->clshead)
         add_lit (ps, NOTLIT (ps->clshead[-1]));
 
+      if (ps->group)
+        add_lit (ps, int2lit (ps, -ps->group));
+
 #ifdef NO_BINARY_CLAUSES
       c =
 #endif
@@ -3049,7 +3226,7 @@ enlarge (PS * ps, unsigned new_size_vars)
   Lit *old_lits = ps->lits;
   Rnk *old_rnks = ps->rnks;
 
-  RESIZEN (ps->lits, 2 * ps->size_vars, 2 * new_size_vars);
+  RESIZEN (ps->lits, 2 * ps->size_vars + LITPAD, 2 * new_size_vars + LITPAD);
   RESIZEN (ps->jwh, 2 * ps->size_vars, 2 * new_size_vars);
   RESIZEN (ps->htps, 2 * ps->size_vars, 2 * new_size_vars);
 #ifndef NDSC
@@ -3334,8 +3511,6 @@ dynamic_flips_per_assignment_per_mille (PS * ps)
   return ps->sdflips / (FFLIPPEDPREC / 1000);
 }
 
-#ifdef NLUBY
-
 static int
 high_agility (PS * ps)
 {
@@ -3348,16 +3523,12 @@ very_high_agility (PS * ps)
   return dynamic_flips_per_assignment_per_mille (ps) >= 250;
 }
 
-#else
-
 static int
 medium_agility (PS * ps)
 {
   return dynamic_flips_per_assignment_per_mille (ps) >= 230;
 }
 
-#endif
-
 static void
 relemdata (PS * ps)
 {
@@ -3625,6 +3796,32 @@ inc_activity (PS * ps, Cls * c)
   *p = addflt (*p, ps->cinc);
 }
 
+/* Recompute the glue of a large learned clause used in conflict analysis,
+ * such that 'reduce' ranks clauses by their current usefulness and not by
+ * the glue they had when they were learned.
+ */
+static void
+update_glue (PS * ps, Cls * c)
+{
+  unsigned glue;
+
+  if (!c->learned)
+    return;
+
+  if (c->size <= 2)
+    return;
+
+  if (c->glue <= 2)
+    return;
+
+  glue = glue_of_lits (ps, c->lits, end_of_lits (c));
+  if (glue >= c->glue)
+    return;
+
+  c->glue = glue;
+  ps->gluepromotions++;
+}
+
 static unsigned
 hashlevel (unsigned l)
 {
@@ -3647,8 +3844,12 @@ pop (PS * ps)
   return *--ps->dhead;
 }
 
-static void
-analyze (PS * ps)
+/* The antecedents of the learned clause are only collected in 'resolved'
+ * if 'resolve' is true, since they are only needed for tracing and the
+ * statistics (see 'add_resolved').
+ */
+static ALWAYS_INLINE void
+analyze_generic (PS * ps, const int resolve)
 {
   unsigned open, minlevel, siglevels, l, old, i, orig;
   Lit *this, *other, **p, **q, **eol;
@@ -3675,8 +3876,11 @@ analyze (PS * ps)
 
   for (;;)
     {
-      add_antecedent (ps, c);
+      if (resolve)
+        add_antecedent (ps, c);
       inc_activity (ps, c);
+      if (ps->opts.glue)
+        update_glue (ps, c);
       eol = end_of_lits (c);
       for (p = c->lits; p < eol; p++)
         {
@@ -3866,7 +4070,8 @@ DONE_FIRST_UIP:
       if (p != eol)
         continue;
 
-      add_antecedent (ps, c);
+      if (resolve)
+        add_antecedent (ps, c);
       v->resolved = 1;
     }
 
@@ -3897,6 +4102,22 @@ DONE_FIRST_UIP:
   ps->mhead = ps->marked;
 }
 
+#define ANALYZE(RESOLVE_) \
+static void \
+analyze_ ## RESOLVE_ (PS * ps) \
+{ \
+  analyze_generic (ps, RESOLVE_); \
+}
+
+ANALYZE (0)
+ANALYZE (1)
+#undef ANALYZE
+
+static void (* const analyze_kernels[]) (PS *) =
+{
+  analyze_0, analyze_1,
+};
+
 static void
 fanalyze (PS * ps)
 {
@@ -4012,10 +4233,10 @@ fanalyze (PS * ps)
 }
 
 /* Propagate assignment of 'this' to 'FALSE' by visiting all binary clauses in
- * which 'this' occurs.
+ * which 'this' occurs.  The statistics are only counted if 'stats' is true.
  */
-inline static void
-prop2 (PS * ps, Lit * this)
+static ALWAYS_INLINE void
+prop2_generic (PS * ps, Lit * this, const int stats)
 {
 #ifdef NO_BINARY_CLAUSES
   Lit ** l, ** start;
@@ -4027,6 +4248,7 @@ prop2 (PS * ps, Lit * this)
   Lit * other;
   Val tmp;
 
+  (void) stats;
   assert (this->val == FALSE);
 
 #ifdef NO_BINARY_CLAUSES
@@ -4040,7 +4262,8 @@ prop2 (PS * ps, Lit * this)
        */
       ps->visits++;
 #ifdef STATS
-      ps->bvisits++;
+      if (stats)
+        ps->bvisits++;
 #endif
       other = *--l;
       tmp = other->val;
@@ -4048,10 +4271,13 @@ prop2 (PS * ps, Lit * this)
       if (tmp == TRUE)
         {
 #ifdef STATS
-          ps->othertrue++;
-          ps->othertrue2++;
-          if (LIT2VAR (other)->level < ps->LEVEL)
-            ps->othertrue2u++;
+          if (stats)
+            {
+              ps->othertrue++;
+              ps->othertrue2++;
+              if (LIT2VAR (other)->level < ps->LEVEL)
+                ps->othertrue2u++;
+            }
 #endif
           continue;
         }
@@ -4075,7 +4301,8 @@ prop2 (PS * ps, Lit * this)
     {
       ps->visits++;
 #ifdef STATS
-      ps->bvisits++;
+      if (stats)
+        ps->bvisits++;
 #endif
       assert (!c->collect);
 #ifdef TRACE
@@ -4097,10 +4324,13 @@ prop2 (PS * ps, Lit * this)
       if (tmp == TRUE)
         {
 #ifdef STATS
-          ps->othertrue++;
-          ps->othertrue2++;
-          if (LIT2VAR (other)->level < ps->LEVEL)
-            ps->othertrue2u++;
+          if (stats)
+            {
+              ps->othertrue++;
+              ps->othertrue2++;
+              if (LIT2VAR (other)->level < ps->LEVEL)
+                ps->othertrue2u++;
+            }
 #endif
           continue;
         }
@@ -4113,6 +4343,22 @@ prop2 (PS * ps, Lit * this)
 #endif /* !defined(NO_BINARY_CLAUSES) */
 }
 
+#define PROP2(STATS_) \
+static void \
+prop2_ ## STATS_ (PS * ps, Lit * this) \
+{ \
+  prop2_generic (ps, this, STATS_); \
+}
+
+PROP2 (0)
+PROP2 (1)
+#undef PROP2
+
+static void (* const prop2_kernels[]) (PS *, Lit *) =
+{
+  prop2_0, prop2_1,
+};
+
 #ifndef NDSC
 static int
 should_disconnect_head_tail (PS * ps, Lit * lit)
@@ -4125,6 +4371,9 @@ should_disconnect_head_tail (PS * ps, Lit * lit)
   v = LIT2VAR (lit);
   litlevel = v->level;
 
+  if (!ps->opts.dsc)
+    return 0;
+
   if (!litlevel)
     return 1;
 
@@ -4137,16 +4386,68 @@ should_disconnect_head_tail (PS * ps, Lit * lit)
 }
 #endif
 
-inline static void
-propl (PS * ps, Lit * this)
+#if SIMD
+
+/* Returns the first literal in '[l, eol)' which is not FALSE, or 'eol'.
+ * The 'Lit' pointers of a clause are the addresses of the values, so the
+ * values of eight literals are gathered (with the following three bytes,
+ * see 'LITPAD') and compared at once.
+ */
+__attribute__ ((target ("avx2"))) static Lit **
+non_false_avx2 (Lit ** l, Lit ** eol)
+{
+  const __m256i byte = _mm256_set1_epi32 (0xff);
+  const __m256i false_val = _mm256_set1_epi32 ((unsigned char) FALSE);
+  __m128i lo, hi;
+  __m256i vals;
+  unsigned mask;
+
+  while (eol - l >= 8)
+    {
+      lo = _mm256_i64gather_epi32 ((const int *) 0,
+                                   _mm256_loadu_si256 ((const __m256i *) l),
+                                   1);
+      hi = _mm256_i64gather_epi32 ((const int *) 0,
+                                   _mm256_loadu_si256 ((const __m256i *)
+                                                       (l + 4)), 1);
+      vals = _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), hi, 1);
+      vals = _mm256_cmpeq_epi32 (_mm256_and_si256 (vals, byte), false_val);
+      mask = (unsigned) _mm256_movemask_ps (_mm256_castsi256_ps (vals));
+      if (mask != 0xff)
+        return l + __builtin_ctz (~mask);
+      l += 8;
+    }
+
+  while (l != eol && (*l)->val == FALSE)
+    l++;
+
+  return l;
+}
+
+#endif
+
+/* Propagate assignment of 'this' to 'FALSE' by visiting all non binary
+ * clauses watched by 'this'.  The statistics, disconnecting satisfied
+ * clauses and the vector search are only used if 'stats', 'dsc' and 'simd'
+ * are true.
+ */
+static ALWAYS_INLINE void
+propl_generic (PS * ps, Lit * this,
+               const int stats, const int dsc, const int simd)
 {
   Lit **l, *other, *prev, *new_lit, **eol;
   Cls *next, **htp_ptr, **new_htp_ptr;
   Cls *c;
+#if SIMD
+  Lit **start;
+#endif
 #ifdef STATS
   unsigned size;
 #endif
 
+  (void) stats;
+  (void) dsc;
+  (void) simd;
   htp_ptr = LIT2HTPS (this);
   assert (this->val == FALSE);
 
@@ -4159,14 +4460,17 @@ propl (PS * ps, Lit * this)
 #ifdef STATS
       size = c->size;
       assert (size >= 3);
-      ps->traversals++; /* other is dereferenced at least */
-
-      if (size == 3)
-        ps->tvisits++;
-      else if (size >= 4)
+      if (stats)
         {
-          ps->lvisits++;
-          ps->ltraversals++;
+          ps->traversals++; /* other is dereferenced at least */
+
+          if (size == 3)
+            ps->tvisits++;
+          else if (size >= 4)
+            {
+              ps->lvisits++;
+              ps->ltraversals++;
+            }
         }
 #endif
 #ifdef TRACE
@@ -4206,17 +4510,21 @@ propl (PS * ps, Lit * this)
       if (other->val == TRUE)
         {
 #ifdef STATS
-          ps->othertrue++;
-          ps->othertruel++;
+          if (stats)
+            {
+              ps->othertrue++;
+              ps->othertruel++;
+            }
 #endif
 #ifndef NDSC
-          if (should_disconnect_head_tail (ps, other))
+          if (dsc && should_disconnect_head_tail (ps, other))
             {
               new_htp_ptr = LIT2DHTPS (other);
               c->next[0] = *new_htp_ptr;
               *new_htp_ptr = c;
 #ifdef STATS
-              ps->othertruelu++;
+              if (stats)
+                ps->othertruelu++;
 #endif
               *htp_ptr = next;
               continue;
@@ -4226,34 +4534,65 @@ propl (PS * ps, Lit * this)
           continue;
         }
 
-      l = c->lits + 1;
       eol = c->lits + c->size;
-      prev = this;
-
-      while (++l != eol)
+#if SIMD
+      start = c->lits + 2;
+      if (simd && c->size >= SIMDSIZE && (*start)->val == FALSE)
         {
+          /* Same order of the literals as the loop below.
+           */
+          l = non_false_avx2 (start, eol);
 #ifdef STATS
-          if (size >= 3)
+          if (stats)
             {
-              ps->traversals++;
-              if (size > 3)
-                ps->ltraversals++;
+              ps->traversals += (l == eol ? eol : l + 1) - start;
+              ps->ltraversals += (l == eol ? eol : l + 1) - start;
             }
 #endif
-          new_lit = *l;
-          *l = prev;
-          prev = new_lit;
-          if (new_lit->val != FALSE) break;
+          if (l != eol)
+            {
+              new_lit = *l;
+              memmove (start + 1, start, (l - start) * sizeof *l);
+              *start = this;
+            }
         }
-
-      if (l == eol)
+      else
+#endif
         {
-          while (l > c->lits + 2)
+          l = c->lits + 1;
+          prev = this;
+
+          while (++l != eol)
             {
-              new_lit = *--l;
+#ifdef STATS
+              if (stats && size >= 3)
+                {
+                  ps->traversals++;
+                  if (size > 3)
+                    ps->ltraversals++;
+                }
+#endif
+              new_lit = *l;
               *l = prev;
               prev = new_lit;
+              if (new_lit->val != FALSE) break;
             }
+
+          if (l == eol)
+            {
+              Lit ** p = l;
+
+              while (p > c->lits + 2)
+                {
+                  new_lit = *--p;
+                  *p = prev;
+                  prev = new_lit;
+                }
+            }
+        }
+
+      if (l == eol)
+        {
           assert (c->lits[0] == this);
 
           assert (other == c->lits[1]);
@@ -4280,6 +4619,51 @@ propl (PS * ps, Lit * this)
     }
 }
 
+#define PROPL(STATS_,DSC_,SIMD_) \
+static void \
+propl_ ## STATS_ ## DSC_ ## SIMD_ (PS * ps, Lit * this) \
+{ \
+  propl_generic (ps, this, STATS_, DSC_, SIMD_); \
+}
+
+PROPL (0, 0, 0)
+PROPL (0, 0, 1)
+PROPL (0, 1, 0)
+PROPL (0, 1, 1)
+PROPL (1, 0, 0)
+PROPL (1, 0, 1)
+PROPL (1, 1, 0)
+PROPL (1, 1, 1)
+#undef PROPL
+
+static void (* const propl_kernels[]) (PS *, Lit *) =
+{
+  propl_000, propl_001, propl_010, propl_011,
+  propl_100, propl_101, propl_110, propl_111,
+};
+
+/* Select the variants of 'propl', 'prop2' and 'analyze' for the features
+ * enabled in this instance, such that the others do not pay for them.  It
+ * has to be called whenever an option or 'trace' changes.
+ */
+static void
+select_kernels (PS * ps)
+{
+  int stats = COUNTSTATS && ps->opts.stats;
+  int dsc = DSC && ps->opts.dsc;
+  int simd = 0, resolve = stats;
+
+#if SIMD
+  simd = ps->avx2 && ps->opts.simd;
+#endif
+#ifdef TRACE
+  resolve |= ps->trace;         /* chains need the resolved clauses */
+#endif
+  ps->propl = propl_kernels[4 * stats + 2 * dsc + simd];
+  ps->prop2 = prop2_kernels[stats];
+  ps->analyze = analyze_kernels[resolve];
+}
+
 #ifndef NADC
 
 static unsigned primes[] = { 996293, 330643, 753947, 500873 };
@@ -4462,12 +4846,12 @@ bcp (PS * ps)
       if (ps->ttail2 < ps->thead)       /* prioritize implications */
         {
           props++;
-          prop2 (ps, NOTLIT (*ps->ttail2++));
+          ps->prop2 (ps, NOTLIT (*ps->ttail2++));
         }
       else if (ps->ttail < ps->thead)   /* unit clauses or clauses with length > 2 */
         {
           if (ps->conflict) break;
-          propl (ps, NOTLIT (*ps->ttail++));
+          ps->propl (ps, NOTLIT (*ps->ttail++));
           if (ps->conflict) break;
         }
 #ifndef NADC
@@ -4683,7 +5067,7 @@ inc_lreduce (PS * ps)
 #ifdef STATS
   ps->inclreduces++;
 #endif
-  ps->lreduce *= FREDUCE;
+  ps->lreduce *= ps->opts.freduce;
   ps->lreduce /= 100;
   report (ps, 1, '+');
 }
@@ -4697,7 +5081,7 @@ backtrack (PS * ps)
   ps->conflicts++;
   LOG ( fprintf (ps->out, "%sconflict ", ps->prefix); dumpclsnl (ps, ps->conflict));
 
-  analyze (ps);
+  ps->analyze (ps);
   new_level = drive (ps);
   // TODO: why not? assert (new_level != 1  || (ps->ahead - ps->added) == 2);
   c = add_simplified_clause (ps, 1);
@@ -4720,7 +5104,7 @@ backtrack (PS * ps)
        * This would be way simpler to implement but for now we keep the more
        * complicated code using the adjust increments and counters.
        */
-      ps->lreduceadjustinc *= FREDADJ; ps->lreduceadjustinc /= 100; ps->lreduceadjustcnt
+      ps->lreduceadjustinc *= ps->opts.fredadj; ps->lreduceadjustinc /= 100; ps->lreduceadjustcnt
       = ps->lreduceadjustinc;
       inc_lreduce (ps);
     }
@@ -4942,30 +5326,26 @@ need_to_reduce (PS * ps)
   return ps->nlclauses >= reduce_limit_on_lclauses (ps);
 }
 
-#ifdef NLUBY
-
 static void
 inc_drestart (PS * ps)
 {
-  ps->drestart *= FRESTART;
+  ps->drestart *= ps->opts.frestart;
   ps->drestart /= 100;
 
-  if (ps->drestart >= MAXRESTART)
-    ps->drestart = MAXRESTART;
+  if (ps->drestart >= (unsigned) ps->opts.maxrestart)
+    ps->drestart = ps->opts.maxrestart;
 }
 
 static void
 inc_ddrestart (PS * ps)
 {
-  ps->ddrestart *= FRESTART;
+  ps->ddrestart *= ps->opts.frestart;
   ps->ddrestart /= 100;
 
-  if (ps->ddrestart >= MAXRESTART)
-    ps->ddrestart = MAXRESTART;
+  if (ps->ddrestart >= (unsigned) ps->opts.maxrestart)
+    ps->ddrestart = ps->opts.maxrestart;
 }
 
-#else
-
 static int
 luby (int i)
 {
@@ -4979,15 +5359,12 @@ luby (int i)
       return luby (i - (1 << (k-1)) + 1);
 }
 
-#endif
-
-#ifndef NLUBY
 static void
 inc_lrestart (PS * ps, int skip)
 {
   unsigned delta;
 
-  delta = 100 * luby (++ps->lubycnt);
+  delta = ps->opts.lubyunit * luby (++ps->lubycnt);
   ps->lrestart = ps->conflicts + delta;
 
   if (ps->waslubymaxdelta)
@@ -5003,44 +5380,105 @@ inc_lrestart (PS * ps, int skip)
   else
     ps->waslubymaxdelta = 0;
 }
-#endif
 
 static void
 init_restart (PS * ps)
 {
-#ifdef NLUBY
-  /* TODO: why is it better in incremental usage to have smaller initial
-   * outer restart interval?
-   */
-  ps->ddrestart = ps->calls > 1 ? MINRESTART : 1000;
-  ps->drestart = MINRESTART;
-  ps->lrestart = ps->conflicts + ps->drestart;
-#else
-  ps->lubycnt = 0;
-  ps->lubymaxdelta = 0;
-  ps->waslubymaxdelta = 0;
-  inc_lrestart (ps, 0);
-#endif
+  if (!ps->opts.luby)
+    {
+      /* TODO: why is it better in incremental usage to have smaller
+       * initial outer restart interval?
+       */
+      ps->ddrestart = ps->calls > 1 ? ps->opts.minrestart : 1000;
+      if (ps->ddrestart > (unsigned) ps->opts.maxrestart)
+        ps->ddrestart = ps->opts.maxrestart;
+      ps->drestart = ps->opts.minrestart;
+      if (ps->drestart > (unsigned) ps->opts.maxrestart)
+        ps->drestart = ps->opts.maxrestart;
+      ps->lrestart = ps->conflicts + ps->drestart;
+    }
+  else
+    {
+      ps->lubycnt = 0;
+      ps->lubymaxdelta = 0;
+      ps->waslubymaxdelta = 0;
+      inc_lrestart (ps, 0);
+    }
+}
+
+/* Determine the level to backtrack to on a restart.  Decisions on the trail
+ * are kept as long as their variables are ranked higher than the next
+ * decision candidate, since the search would take exactly these decisions
+ * again after backtracking to the top level, and propagate them again.
+ * Decisions on assumptions are kept as well for the same reason.
+ */
+static unsigned
+reuse_trail (PS * ps)
+{
+  Lit ** p, * lit;
+  unsigned res;
+  Rnk * next;
+  Var * v;
+
+  while (ps->hhead > ps->heap + 1)
+    {
+      next = htop (ps);
+      if (RNK2LIT (next)->val == UNDEF)
+        break;
+      (void) hpop (ps);
+    }
+
+  if (ps->hhead == ps->heap + 1)
+    return 0;
+
+  next = htop (ps);
+
+  res = 0;
+  for (p = ps->trail; p < ps->thead; p++)
+    {
+      lit = *p;
+      v = LIT2VAR (lit);
+
+      if (!v->level || v->reason)
+        continue;
+
+      assert (v->level == res + 1);
+
+      if (v->level > ps->adecidelevel &&
+          cmp_rnk (VAR2RNK (v), next) < 0)
+        break;
+
+      res = v->level;
+    }
+
+  if (res)
+    {
+      ps->reusedtrails++;
+      ps->reusedlevels += res;
+    }
+
+  return res;
 }
 
 static void
 restart (PS * ps)
 {
-  int skip;
-#ifdef NLUBY
+  int skip, outer;
   char kind;
-  int outer;
 
-  inc_drestart (ps);
-  outer = (ps->drestart >= ps->ddrestart);
+  outer = 0;
+  if (!ps->opts.luby)
+    {
+      inc_drestart (ps);
+      outer = (ps->drestart >= ps->ddrestart);
 
-  if (outer)
-    skip = very_high_agility (ps);
+      if (outer)
+        skip = very_high_agility (ps);
+      else
+        skip = high_agility (ps);
+    }
   else
-    skip = high_agility (ps);
-#else
-  skip = medium_agility (ps);
-#endif
+    skip = medium_agility (ps);
 
 #ifdef STATS
   if (skip)
@@ -5054,15 +5492,22 @@ restart (PS * ps)
       ps->restarts++;
       assert (ps->LEVEL > 1);
       LOG ( fprintf (ps->out, "%srestart %u\n", ps->prefix, ps->restarts));
-      undo (ps, 0);
+      undo (ps, ps->opts.reusetrail ? reuse_trail (ps) : 0);
     }
 
-#ifdef NLUBY
-  if (outer)
+  if (ps->opts.luby)
     {
-      kind = skip ? 'N' : 'R';
+      inc_lrestart (ps, skip);
+      return;
+    }
+
+  if (outer)
+    {
+      kind = skip ? 'N' : 'R';
       inc_ddrestart (ps);
-      ps->drestart = MINRESTART;
+      ps->drestart = ps->opts.minrestart;
+      if (ps->drestart > (unsigned) ps->opts.maxrestart)
+        ps->drestart = ps->opts.maxrestart;
     }
   else  if (skip)
     {
@@ -5073,14 +5518,11 @@ restart (PS * ps)
       kind = 'r';
     }
 
-  assert (ps->drestart <= MAXRESTART);
+  assert (ps->drestart <= (unsigned) ps->opts.maxrestart);
   ps->lrestart = ps->conflicts + ps->drestart;
   assert (ps->lrestart > ps->conflicts);
 
-  report (outer ? 1 : 2, kind);
-#else
-  inc_lrestart (ps, skip);
-#endif
+  report (ps, outer ? 1 : 2, kind);
 }
 
 inline static void
@@ -5098,6 +5540,50 @@ assign_decision (PS * ps, Lit * lit)
   assign (ps, lit, 0);
 }
 
+/* Account for one round of an inprocessing technique.  Rounds which did not
+ * remove anything halve the budget.  Rounds which were at least as effective
+ * as the average of all previous rounds increase it by 50%.
+ */
+static void
+inp_adapt (PS * ps, Inp * inp,
+           unsigned long long ticks, unsigned long long removed)
+{
+  double this_round, so_far;
+
+  (void) ps;
+  so_far = AVERAGE (inp->removed, inp->ticks);
+  this_round = AVERAGE (removed, ticks);
+
+  inp->calls++;
+  inp->ticks += ticks;
+  inp->removed += removed;
+
+  if (!removed)
+    inp->budget /= 2;
+  else if (this_round >= so_far)
+    inp->budget += inp->budget / 2;
+
+  if (inp->budget < INPMINBUDGET)
+    inp->budget = INPMINBUDGET;
+
+  if (inp->budget > INPMAXBUDGET)
+    inp->budget = INPMAXBUDGET;
+
+  LOG ( fprintf (ps->out,
+                 "%s%s removed %llu in %llu ticks, new budget %u per mille\n",
+                 ps->prefix, inp->name, removed, ticks, inp->budget));
+}
+
+/* Number of ticks the search has to spend before a technique which just
+ * spent 'ticks' ticks is scheduled again.
+ */
+static unsigned long long
+inp_delay (Inp * inp, unsigned long long ticks)
+{
+  assert (inp->budget);
+  return ticks * (1000 - inp->budget) / inp->budget;
+}
+
 #ifndef NFL
 
 static int
@@ -5169,7 +5655,8 @@ faillits (PS * ps)
 {
   unsigned i, j, old_trail_count, common, saved_count;
   unsigned new_saved_size, oldladded = ps->ladded;
-  unsigned long long limit, delta;
+  unsigned oldfailedlits = ps->failedlits;
+  unsigned long long limit, delta, ticks;
   Lit * lit, * other, * pivot;
   Rnk * r, ** p, ** q;
   int new_trail_count;
@@ -5188,7 +5675,7 @@ faillits (PS * ps)
 #ifdef STATSA
   ps->flrounds++;
 #endif
-  delta = ps->propagations/10;
+  delta = ps->propagations * ps->probing.budget / 1000;
   if (delta >= 100*1000*1000) delta = 100*1000*1000;
   else if (delta <= 100*1000) delta = 100*1000;
 
@@ -5424,7 +5911,9 @@ CONTRADICTION:
 #endif
     }
 
-  ps->fllimit += 9 * (ps->propagations - ps->fllimit);  /* 10% for failed literals */
+  ticks = ps->propagations - ps->fllimit;
+  inp_adapt (ps, &ps->probing, ticks, ps->failedlits - oldfailedlits);
+  ps->fllimit += inp_delay (&ps->probing, ticks);
 
 RETURN:
 
@@ -5458,7 +5947,7 @@ static void
 simplify (PS * ps, int forced)
 {
   Lit * lit, * notlit, ** t;
-  unsigned collect, delta;
+  unsigned long long collect, ticks, delta;
 #ifdef STATS
   size_t bytes_collected;
 #endif
@@ -5479,7 +5968,8 @@ simplify (PS * ps, int forced)
     undo (ps, 0);
 #ifndef NFL
   ps->simplifying = 1;
-  faillits (ps);
+  if (ps->opts.probe)
+    faillits (ps);
   ps->simplifying = 0;
 
   if (ps->mtcls)
@@ -5495,7 +5985,7 @@ simplify (PS * ps, int forced)
         {
           lit = *t;
           v = LIT2VAR (lit);
-          if (v->internal)
+          if (v->internal && !v->group)
             {
               assert (LIT2INT (lit) < 0);
               assert (lit->val == TRUE);
@@ -5523,7 +6013,7 @@ simplify (PS * ps, int forced)
         }
     }
 
-  collect = 0;
+  collect = ticks = 0;
   for (p = SOC; p != EOC; p = NXC (p))
     {
       c = *p;
@@ -5539,6 +6029,7 @@ simplify (PS * ps, int forced)
         continue;
 
       assert (!c->collect);
+      ticks += c->size;
       if (clause_is_toplevel_satisfied (ps, c))
         {
           mark_clause_to_be_collected (c);
@@ -5546,7 +6037,7 @@ simplify (PS * ps, int forced)
         }
     }
 
-  LOG ( fprintf (ps->out, "%scollecting %d clauses\n", ps->prefix, collect));
+  LOG ( fprintf (ps->out, "%scollecting %llu clauses\n", ps->prefix, collect));
 #ifdef STATS
   bytes_collected =
 #endif
@@ -5575,7 +6066,8 @@ simplify (PS * ps, int forced)
       ps->cilshead = ps->cils;
     }
 
-  delta = 10 * (ps->olits + ps->llits) + 100000;
+  inp_adapt (ps, &ps->collecting, ticks, collect);
+  delta = inp_delay (&ps->collecting, ticks) + 100000;
   if (delta > 2000000)
     delta = 2000000;
   ps->lsimplify = ps->propagations + delta;
@@ -5594,12 +6086,15 @@ iteration (PS * ps)
 
   ps->iterations++;
   report (ps, 2, 'i');
-#ifdef NLUBY
-  ps->drestart = MINRESTART;
-  ps->lrestart = ps->conflicts + ps->drestart;
-#else
-  init_restart (ps);
-#endif
+  if (!ps->opts.luby)
+    {
+      ps->drestart = ps->opts.minrestart;
+      if (ps->drestart > (unsigned) ps->opts.maxrestart)
+        ps->drestart = ps->opts.maxrestart;
+      ps->lrestart = ps->conflicts + ps->drestart;
+    }
+  else
+    init_restart (ps);
   ps->isimplify = ps->fixed;
 }
 
@@ -5746,7 +6241,7 @@ static void
 init_reduce (PS * ps)
 {
   // lreduce = loadded / 2;
-  ps->lreduce = 1000;
+  ps->lreduce = ps->opts.initreduce;
 
   if (ps->lreduce < 100)
     ps->lreduce = 100;
@@ -5881,21 +6376,63 @@ gcd (unsigned a, unsigned b)
   return a;
 }
 
+/* The top of the heap after removing assigned variables */
+static Rnk *
+htop_undef (PS * ps)
+{
+  Rnk *r;
+
+  for (;;)
+    {
+      r = htop (ps);
+      if (RNK2LIT (r)->val == UNDEF) break;
+      (void) hpop (ps);
+      NOLOG ( fprintf (ps->out,
+                      "%shpop %u %u %u\n",
+                      ps->prefix, r - ps->rnks,
+                      FLTMANTISSA(r->score),
+                      FLTEXPONENT(r->score)));
+    }
+
+  return r;
+}
+
+/* Whether the variable of 'lit' is unassigned and has the importance and
+ * priority of 'top', such that random decisions respect the tiers.
+ */
+static int
+rdecidable (PS * ps, Lit * lit, Rnk * top)
+{
+  Rnk *r = VAR2RNK (LIT2VAR (lit));
+
+  return lit->val == UNDEF &&
+         r->moreimportant == top->moreimportant &&
+         r->lessimportant == top->lessimportant &&
+         r->priority == top->priority;
+}
+
 static Lit *
 rdecide (PS * ps)
 {
   unsigned idx, delta, spread;
   Lit * res;
+  Rnk * top;
+
+  spread = ps->opts.rdecide;
+  if (!spread)
+    return 0;
 
-  spread = RDECIDE;
-  if (rrng (ps, 1, spread) != 2)
+  if (spread > 1 && rrng (ps, 1, spread) != 2)
     return 0;
 
+  /* only variables of the highest tier with unassigned variables */
+  top = htop_undef (ps);
+
   assert (1 <= ps->max_var);
   idx = rrng (ps, 1, ps->max_var);
   res = int2lit (ps, idx);
 
-  if (res->val != UNDEF)
+  if (!rdecidable (ps, res, top))
     {
       delta = rrng (ps, 1, ps->max_var);
       while (gcd (delta, ps->max_var) != 1)
@@ -5909,7 +6446,7 @@ rdecide (PS * ps)
         if (idx > ps->max_var)
           idx -= ps->max_var;
         res = int2lit (ps, idx);
-      } while (res->val != UNDEF);
+      } while (!rdecidable (ps, res, top));
     }
 
 #ifdef STATS
@@ -5925,20 +6462,8 @@ static Lit *
 sdecide (PS * ps)
 {
   Lit *res;
-  Rnk *r;
 
-  for (;;)
-    {
-      r = htop (ps);
-      res = RNK2LIT (r);
-      if (res->val == UNDEF) break;
-      (void) hpop (ps);
-      NOLOG ( fprintf (ps->out,
-                      "%shpop %u %u %u\n",
-                      ps->prefix, r - ps->rnks,
-                      FLTMANTISSA(r->score),
-                      FLTEXPONENT(r->score)));
-    }
+  res = RNK2LIT (htop_undef (ps));
 
 #ifdef STATS
   ps->sdecisions++;
@@ -6093,6 +6618,11 @@ SATISFIED:
       if (ps->propagations >= ps->lpropagations)/* propagation limit reached ? */
         return PICOSAT_UNKNOWN;
 
+      if (ps->interrupt.function &&             /* external interrupt ? */
+          count > 0 && !(count % INTERRUPTLIM) &&
+          ps->interrupt.function (ps->interrupt.state))
+        return PICOSAT_UNKNOWN;
+
 #ifndef NADC
       if (!ps->adodisabled && ps->adoconflicts >= ps->adoconflictlimit)
         {
@@ -6118,7 +6648,7 @@ SATISFIED:
         }
 
       if (need_to_reduce (ps))
-        reduce (ps, 50);
+        reduce (ps, ps->opts.reduce);
 
       if (ps->conflicts >= ps->lrestart && ps->LEVEL > 2)
         restart (ps);
@@ -6484,6 +7014,8 @@ import_lit (PS * ps, int lit, int nointernal)
   ABORTIF (lit == INT_MIN, "API usage: INT_MIN literal");
   ABORTIF (abs (lit) > (int) ps->max_var && ps->CLS != ps->clshead,
            "API usage: new variable index after 'picosat_push'");
+  ABORTIF (abs (lit) > (int) ps->max_var && ps->grps != ps->grpshead,
+           "API usage: new variable index after 'picosat_new_group'");
 
   if (abs (lit) <= (int) ps->max_var)
     {
@@ -6582,8 +7114,12 @@ reset_partial (PS * ps)
   ps->partial = 0;
 }
 
+/* Reset to the 'READY' state, but keep the decision levels up to 'keep'.
+ * This is only valid if these levels are also used in the next call, see
+ * 'picosat_sat_assuming'.
+ */
 static void
-reset_incremental_usage (PS * ps)
+reset_incremental_usage_keeping (PS * ps, unsigned keep)
 {
   unsigned num_non_false;
   Lit * lit, ** q;
@@ -6592,8 +7128,8 @@ reset_incremental_usage (PS * ps)
 
   LOG ( fprintf (ps->out, "%sRESET incremental usage\n", ps->prefix));
 
-  if (ps->LEVEL)
-    undo (ps, 0);
+  if (ps->LEVEL > keep)
+    undo (ps, keep);
 
   reset_assumptions (ps);
 
@@ -6632,6 +7168,12 @@ reset_incremental_usage (PS * ps)
   ps->state = READY;
 }
 
+static void
+reset_incremental_usage (PS * ps)
+{
+  reset_incremental_usage_keeping (ps, 0);
+}
+
 static void
 enter (PS * ps)
 {
@@ -6760,6 +7302,8 @@ picosat_adjust (PS * ps, int new_max_var)
 
   ABORTIF (abs (new_max_var) > (int) ps->max_var && ps->CLS != ps->clshead,
            "API usage: adjusting variable index after 'picosat_push'");
+  ABORTIF (abs (new_max_var) > (int) ps->max_var && ps->grps != ps->grpshead,
+           "API usage: adjusting variable index after 'picosat_new_group'");
   enter (ps);
 
   new_max_var = abs (new_max_var);
@@ -6796,21 +7340,14 @@ picosat_context (PS * ps)
   return ps->clshead == ps->CLS ? 0 : LIT2INT (ps->clshead[-1]);
 }
 
-int
-picosat_push (PS * ps)
+/* Get a recycled or new internal variable for a context or clause group.
+ */
+static int
+new_internal (PS * ps)
 {
   int res;
-  Lit *lit;
   Var * v;
 
-  if (ps->measurealltimeinlib)
-    enter (ps);
-  else
-    check_ready (ps);
-
-  if (ps->state != READY)
-    reset_incremental_usage (ps);
-
   if (ps->rils != ps->rilshead)
     {
       res = *--ps->rilshead;
@@ -6827,6 +7364,44 @@ picosat_push (PS * ps)
       LOG ( fprintf (ps->out, "%snew internal variable index %d\n", ps->prefix, res));
     }
 
+  return res;
+}
+
+/* The clauses of closed contexts and deleted groups are removed during the
+ * next simplification, which is forced if there are too many of them.
+ */
+static void
+close_internal (PS * ps, int ilit)
+{
+  assert (ps->vars[ilit].internal);
+
+  if (ps->cilshead == ps->eocils)
+    ENLARGE (ps->cils, ps->cilshead, ps->eocils);
+  *ps->cilshead++ = ilit;
+
+  if (ps->cilshead - ps->cils > MAXCILS && !ps->mtcls) {
+    LOG ( fprintf (ps->out,
+                  "%srecycling %ld interals with forced simplification\n",
+                  ps->prefix, (long)(ps->cilshead - ps->cils)));
+    simplify (ps, 1);
+  }
+}
+
+int
+picosat_push (PS * ps)
+{
+  int res;
+  Lit *lit;
+
+  if (ps->measurealltimeinlib)
+    enter (ps);
+  else
+    check_ready (ps);
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  res = new_internal (ps);
   lit = int2lit (ps, res);
 
   if (ps->clshead == ps->eocls)
@@ -6865,16 +7440,7 @@ picosat_pop (PS * ps)
   LOG ( fprintf (ps->out, "%sclosing context %d at depth %ld after pop\n",
                  ps->prefix, LIT2INT (lit), (long)(ps->clshead - ps->CLS) + 1));
 
-  if (ps->cilshead == ps->eocils)
-    ENLARGE (ps->cils, ps->cilshead, ps->eocils);
-  *ps->cilshead++ = LIT2INT (lit);
-
-  if (ps->cilshead - ps->cils > MAXCILS) {
-    LOG ( fprintf (ps->out,
-                  "%srecycling %ld interals with forced simplification\n",
-                  ps->prefix, (long)(ps->cilshead - ps->cils)));
-    simplify (ps, 1);
-  }
+  close_internal (ps, LIT2INT (lit));
 
   res = picosat_context (ps);
   if (res)
@@ -6889,6 +7455,121 @@ picosat_pop (PS * ps)
   return res;
 }
 
+static Var *
+check_group (PS * ps, int group)
+{
+  Var * v;
+
+  ABORTIF (group <= 0 || group > (int) ps->max_var,
+           "API usage: invalid group");
+  v = ps->vars + group;
+  ABORTIF (!v->group, "API usage: invalid group");
+
+  return v;
+}
+
+int
+picosat_new_group (PS * ps)
+{
+  int res;
+  Var * v;
+
+  if (ps->measurealltimeinlib)
+    enter (ps);
+  else
+    check_ready (ps);
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  res = new_internal (ps);
+  v = ps->vars + res;
+  assert (!v->group);
+  v->group = 1;
+  v->disabled = 0;
+
+  if (ps->grpshead == ps->eogrps)
+    ENLARGE (ps->grps, ps->grpshead, ps->eogrps);
+  *ps->grpshead++ = res;
+
+  ps->groups++;
+
+  LOG ( fprintf (ps->out, "%snew group %d\n", ps->prefix, res));
+
+  if (ps->measurealltimeinlib)
+    leave (ps);
+
+  return res;
+}
+
+void
+picosat_set_group (PS * ps, int group)
+{
+  check_ready (ps);
+  ABORTIF (ps->added != ps->ahead, "API usage: incomplete clause");
+  if (group)
+    (void) check_group (ps, group);
+  ps->group = group;
+}
+
+void
+picosat_enable_group (PS * ps, int group)
+{
+  check_ready (ps);
+  check_group (ps, group)->disabled = 0;
+}
+
+void
+picosat_disable_group (PS * ps, int group)
+{
+  check_ready (ps);
+  check_group (ps, group)->disabled = 1;
+}
+
+int
+picosat_group_enabled (PS * ps, int group)
+{
+  check_ready (ps);
+  return !check_group (ps, group)->disabled;
+}
+
+void
+picosat_delete_group (PS * ps, int group)
+{
+  int * p;
+  Var * v;
+
+  ABORTIF (ps->added != ps->ahead, "API usage: incomplete clause");
+
+  if (ps->measurealltimeinlib)
+    enter (ps);
+  else
+    check_ready (ps);
+
+  v = check_group (ps, group);
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  LOG ( fprintf (ps->out, "%sdeleting group %d\n", ps->prefix, group));
+
+  for (p = ps->grps; *p != group; p++)
+    assert (p + 1 < ps->grpshead);
+  while (++p < ps->grpshead)
+    p[-1] = *p;
+  ps->grpshead--;
+
+  if (ps->group == group)
+    ps->group = 0;
+
+  v->group = 0;
+  v->disabled = 0;
+  close_internal (ps, group);
+
+  if (ps->measurealltimeinlib)
+    leave (ps);
+}
+
 void
 picosat_set_verbosity (PS * ps, int new_verbosity_level)
 {
@@ -6905,6 +7586,7 @@ picosat_enable_trace_generation (PS * ps)
   ABORTIF (ps->addedclauses,
            "API usage: trace generation enabled after adding clauses");
   res = ps->trace = 1;
+  select_kernels (ps);
 #endif
   return res;
 }
@@ -6947,6 +7629,90 @@ picosat_set_seed (PS * ps, unsigned s)
   ps->srng = s;
 }
 
+typedef struct Opt
+{
+  const char * name;
+  size_t offset;
+  int def, min, max;
+  const char * description;
+} Opt;
+
+static const Opt opt_table[] =
+{
+#define OPTION(NAME,DEFAULT,MIN,MAX,DESCRIPTION) \
+  { #NAME, offsetof (Opts, NAME), DEFAULT, MIN, MAX, DESCRIPTION },
+  OPTIONS
+#undef OPTION
+  { 0, 0, 0, 0, 0, 0 }
+};
+
+static const Opt *
+find_opt (const char * name)
+{
+  const Opt * o;
+
+  for (o = opt_table; o->name; o++)
+    if (!strcmp (o->name, name))
+      return o;
+
+  return 0;
+}
+
+#define OPT2PTR(o) ((int*)(((char*) &ps->opts) + (o)->offset))
+
+int
+picosat_has_option (const char * name)
+{
+  return find_opt (name) != 0;
+}
+
+int
+picosat_set_option (PS * ps, const char * name, int value)
+{
+  const Opt * o;
+
+  check_ready (ps);
+  o = find_opt (name);
+  if (!o || value < o->min || value > o->max)
+    return 0;
+
+  *OPT2PTR (o) = value;
+  select_kernels (ps);
+  return 1;
+}
+
+int
+picosat_get_option (PS * ps, const char * name)
+{
+  const Opt * o;
+
+  check_ready (ps);
+  o = find_opt (name);
+  ABORTIF (!o, "API usage: 'picosat_get_option' with invalid option");
+  return *OPT2PTR (o);
+}
+
+void
+picosat_copy_options (PS * ps, PS * src)
+{
+  check_ready (ps);
+  check_ready (src);
+  ps->opts = src->opts;
+  select_kernels (ps);
+}
+
+void
+picosat_print_options (PS * ps, FILE * file)
+{
+  const Opt * o;
+
+  check_ready (ps);
+  for (o = opt_table; o->name; o++)
+    fprintf (file, "%s%-10s %10d   [%d,%d] %s\n",
+             ps->prefix, o->name, *OPT2PTR (o), o->min, o->max,
+             o->description);
+}
+
 void
 picosat_reset (PS * ps)
 {
@@ -6996,6 +7762,60 @@ picosat_add (PS * ps, int int_lit)
   return res;
 }
 
+int
+picosat_add_lits (PS * ps, int * lits)
+{
+  int res = ps->oadded;
+  const int *p;
+  Lit *lit;
+
+  if (ps->measurealltimeinlib)
+    enter (ps);
+  else
+    check_ready (ps);
+
+  ABORTIF (ps->rup && ps->rupstarted && ps->oadded >= (unsigned)ps->rupclauses,
+           "API usage: adding too many clauses after RUP header written");
+#ifndef NADC
+  ABORTIF (ps->addingtoado,
+           "API usage: 'picosat_add_lits' and 'picosat_add_ado_lit' mixed");
+#endif
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  /* same as 'picosat_add' for each literal and the terminating zero, but
+   * with the checks above done once per clause
+   */
+  for (p = lits; *p; p++)
+    {
+      if (ps->saveorig)
+        {
+          if (ps->sohead == ps->eoso)
+            ENLARGE (ps->soclauses, ps->sohead, ps->eoso);
+
+          *ps->sohead++ = *p;
+        }
+
+      lit = import_lit (ps, *p, 1);
+      add_lit (ps, lit);
+    }
+
+  if (ps->saveorig)
+    {
+      if (ps->sohead == ps->eoso)
+        ENLARGE (ps->soclauses, ps->sohead, ps->eoso);
+
+      *ps->sohead++ = 0;
+    }
+
+  simplify_and_add_original_clause (ps);
+
+  if (ps->measurealltimeinlib)
+    leave (ps);
+
+  return res;
+}
+
 void
 picosat_add_ado_lit (PS * ps, int external_lit)
 {
@@ -7051,10 +7871,13 @@ static void
 assume_contexts (PS * ps)
 {
   Lit ** p;
+  int * q;
   if (ps->als != ps->alshead)
     return;
   for (p = ps->CLS; p != ps->clshead; p++)
     assume (ps, *p);
+  for (q = ps->grps; q != ps->grpshead; q++)
+    assume (ps, int2lit (ps, ps->vars[*q].disabled ? -*q : *q));
 }
 
 static const char * enumstr (int i) {
@@ -7231,6 +8054,233 @@ picosat_sat (PS * ps, int l)
   return res;
 }
 
+/* Determine the decision levels of the last satisfiable call which only
+ * consist of decisions on a common prefix of its assumptions and the
+ * assumptions of the next call, i.e. the contexts, groups and 'lits'.
+ */
+static unsigned
+kept_assumption_levels (PS * ps, const int * lits)
+{
+  Lit ** p, ** q, ** eoc, ** t, ** n, * lit;
+  unsigned res, size;
+  const int * r;
+  int * g;
+  Var * v;
+
+  assert (ps->state == SAT);
+
+  size = (ps->clshead - ps->CLS) + (ps->grpshead - ps->grps);
+  for (r = lits; *r; r++)
+    size++;
+
+  NEWN (n, size ? size : 1);
+  q = n;
+  for (p = ps->CLS; p != ps->clshead; p++)
+    *q++ = *p;
+  for (g = ps->grps; g != ps->grpshead; g++)
+    *q++ = int2lit (ps, ps->vars[*g].disabled ? -*g : *g);
+  for (r = lits; *r; r++)
+    *q++ = int2lit (ps, *r);
+  assert (q == n + size);
+
+  eoc = ps->als;
+  while (eoc < ps->alshead && eoc - ps->als < (long) size &&
+         *eoc == n[eoc - ps->als])
+    eoc++;
+
+  DELETEN (n, size ? size : 1);
+
+  res = 0;
+  p = ps->als;
+  for (t = ps->trail; t < ps->thead; t++)
+    {
+      lit = *t;
+      v = LIT2VAR (lit);
+
+      if (!v->level || v->reason)
+        continue;
+
+      if (v->level > ps->adecidelevel)
+        break;
+
+      while (p < eoc && *p != lit)
+        p++;
+
+      if (p == eoc)
+        break;
+
+      res = v->level;
+      p++;
+    }
+
+  return res;
+}
+
+int
+picosat_sat_assuming (PS * ps, const int * lits, int l)
+{
+  unsigned keep;
+  const int * p;
+
+  check_ready (ps);
+
+  keep = 0;
+  if (ps->state == SAT)
+    {
+      for (p = lits; *p; p++)
+        if (*p == INT_MIN || abs (*p) > (int) ps->max_var)
+          break;
+
+      if (!*p)
+        keep = kept_assumption_levels (ps, lits);
+    }
+
+  if (ps->state != READY)
+    {
+      reset_incremental_usage_keeping (ps, keep);
+      if (keep)
+        {
+          ps->keptassumptions++;
+          ps->keptlevels += keep;
+        }
+    }
+
+  for (p = lits; *p; p++)
+    picosat_assume (ps, *p);
+
+  return picosat_sat (ps, l);
+}
+
+static void
+push_plit (PS * ps, int ilit)
+{
+  if (ps->plitshead == ps->eoplits)
+    ENLARGE (ps->plits, ps->plitshead, ps->eoplits);
+  *ps->plitshead++ = ilit;
+}
+
+int
+picosat_propagate (PS * ps, const int * lits)
+{
+  Lit ** p, * lit;
+  const int * r;
+  int res;
+  Var * v;
+
+  enter (ps);
+  ABORTIF (ps->added < ps->ahead, "API usage: incomplete clause");
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  assume_contexts (ps);
+  for (r = lits; *r; r++)
+    assume (ps, import_lit (ps, *r, 1));
+
+  ps->plitshead = ps->plits;
+  res = PICOSAT_UNKNOWN;
+
+  if (!ps->conflict)
+    bcp (ps);
+
+  if (ps->conflict)
+    backtrack (ps);
+
+  if (ps->mtcls)
+    res = PICOSAT_UNSATISFIABLE;
+  else
+    {
+      assert (!ps->LEVEL);
+      for (p = ps->als; p < ps->alshead; p++)
+        {
+          lit = *p;
+
+          if (lit->val == TRUE)
+            continue;
+
+          if (lit->val == FALSE)
+            {
+              /* report the assumption as falsified unit clause */
+              if (!LIT2VAR (lit)->internal)
+                push_plit (ps, LIT2INT (lit));
+              res = PICOSAT_UNSATISFIABLE;
+              break;
+            }
+
+          assign_decision (ps, lit);
+          bcp (ps);
+
+          if (ps->conflict)
+            {
+              for (p = ps->conflict->lits; p < end_of_lits (ps->conflict); p++)
+                if (!LIT2VAR (*p)->internal)
+                  push_plit (ps, LIT2INT (*p));
+              res = PICOSAT_UNSATISFIABLE;
+              break;
+            }
+        }
+    }
+
+  if (res == PICOSAT_UNKNOWN)
+    {
+      for (p = ps->trail; p < ps->thead; p++)
+        {
+          lit = *p;
+          v = LIT2VAR (lit);
+          if (v->level && v->reason && !v->internal)
+            push_plit (ps, LIT2INT (lit));
+        }
+    }
+
+  push_plit (ps, 0);
+
+  if (ps->LEVEL)
+    undo (ps, 0);
+
+  reset_assumptions (ps);
+  leave (ps);
+
+  return res;
+}
+
+const int *
+picosat_propagated (PS * ps)
+{
+  check_ready (ps);
+  ABORTIF (!ps->plits, "API usage: 'picosat_propagated' without 'picosat_propagate'");
+  return ps->plits;
+}
+
+static void
+push_dlit (PS * ps, int ilit)
+{
+  if (ps->dlitshead == ps->eodlits)
+    ENLARGE (ps->dlits, ps->dlitshead, ps->eodlits);
+  *ps->dlitshead++ = ilit;
+}
+
+const int *
+picosat_decision_lits (PS * ps)
+{
+  Lit ** p, * lit;
+  Var * v;
+
+  check_ready (ps);
+  check_sat_state (ps);
+
+  ps->dlitshead = ps->dlits;
+  for (p = ps->trail; p < ps->thead; p++)
+    {
+      lit = *p;
+      v = LIT2VAR (lit);
+      if (v->level > ps->adecidelevel && !v->reason && !v->internal)
+        push_dlit (ps, LIT2INT (lit));
+    }
+  push_dlit (ps, 0);
+
+  return ps->dlits;
+}
+
 int
 picosat_res (PS * ps)
 {
@@ -8020,6 +9070,15 @@ picosat_set_propagation_limit (PS * ps, unsigned long long l)
   ps->lpropagations = l;
 }
 
+void
+picosat_set_interrupt (PS * ps,
+                       void * external_state,
+                       int (*interrupted)(void * external_state))
+{
+  ps->interrupt.state = external_state;
+  ps->interrupt.function = interrupted;
+}
+
 unsigned long long
 picosat_propagations (PS * ps)
 {
@@ -8032,6 +9091,12 @@ picosat_visits (PS * ps)
   return ps->visits;
 }
 
+unsigned long long
+picosat_conflicts (PS * ps)
+{
+  return ps->conflicts;
+}
+
 unsigned long long
 picosat_decisions (PS * ps)
 {
@@ -8052,6 +9117,16 @@ picosat_added_original_clauses (PS * ps)
   return (int) ps->oadded;
 }
 
+static void
+inp_stats (PS * ps, Inp * inp)
+{
+  fprintf (ps->out,
+           "%s%s: %u rounds, %llu ticks, %llu removed"
+           " (%.1f per mega tick), budget %.1f%%\n",
+           ps->prefix, inp->name, inp->calls, inp->ticks, inp->removed,
+           AVERAGE (inp->removed, inp->ticks / 1e6), inp->budget / 10.0);
+}
+
 void
 picosat_stats (PS * ps)
 {
@@ -8070,12 +9145,22 @@ picosat_stats (PS * ps)
 #endif
        fprintf (ps->out, "\n");
     }
+  if (ps->groups)
+    fprintf (ps->out, "%s%u clause groups\n", ps->prefix, ps->groups);
    fprintf (ps->out, "%s%u iterations\n", ps->prefix, ps->iterations);
    fprintf (ps->out, "%s%u restarts", ps->prefix, ps->restarts);
 #ifdef STATS
    fprintf (ps->out, " (%u skipped)", ps->skippedrestarts);
 #endif
   fputc ('\n', ps->out);
+   fprintf (ps->out, "%s%u reused trails (%.1f%% of restarts, %.1f levels)\n",
+           ps->prefix, ps->reusedtrails,
+           PERCENT (ps->reusedtrails, ps->restarts),
+           AVERAGE (ps->reusedlevels, ps->reusedtrails));
+  if (ps->keptassumptions)
+    fprintf (ps->out, "%s%u calls kept assumptions (%.1f levels)\n",
+             ps->prefix, ps->keptassumptions,
+             AVERAGE (ps->keptlevels, ps->keptassumptions));
 #ifndef NFL
    fprintf (ps->out, "%s%u failed literals", ps->prefix, ps->failedlits);
 #ifdef STATS
@@ -8091,7 +9176,9 @@ picosat_stats (PS * ps)
     ps->ifailedlits, PERCENT (ps->ifailedlits, ps->failedlits),
     ps->floopsed, ps->fltried, ps->flskipped);
 #endif
+  inp_stats (ps, &ps->probing);
 #endif
+  inp_stats (ps, &ps->collecting);
    fprintf (ps->out, "%s%u conflicts", ps->prefix, ps->conflicts);
 #ifdef STATS
    fprintf (ps->out, " (%u uips = %.1f%%)\n", ps->uips, PERCENT(ps->uips,ps->conflicts));
@@ -8124,6 +9211,7 @@ picosat_stats (PS * ps)
    fprintf (ps->out, "%s%u learned literals\n", ps->prefix, ps->llitsadded);
    fprintf (ps->out, "%s%.1f%% deleted literals\n",
      ps->prefix, PERCENT (redlits, ps->nonminimizedllits));
+   fprintf (ps->out, "%s%llu glue promotions\n", ps->prefix, ps->gluepromotions);
 
 #ifdef STATS
 #ifndef NO_BINARY_CLAUSES
@@ -8426,6 +9514,26 @@ picosat_set_default_phase_lit (PS * ps, int int_lit, int phase)
     }
 }
 
+void
+picosat_set_default_phase_lits (PS * ps, const int * lits, int n)
+{
+  const int * p, * eol;
+  Lit * lit;
+  Var * v;
+
+  check_ready (ps);
+
+  eol = lits + n;
+  for (p = lits; p < eol; p++)
+    {
+      ABORTIF (!*p, "API usage: zero literal as default phase");
+      lit = import_lit (ps, *p, 1);
+      v = LIT2VAR (lit);
+      v->defphase = v->phase = (*p > 0);
+      v->usedefphase = v->assigned = 1;
+    }
+}
+
 void
 picosat_set_more_important_lit (PS * ps, int int_lit)
 {
@@ -8474,6 +9582,32 @@ picosat_set_less_important_lit (PS * ps, int int_lit)
     hdown (ps, r);
 }
 
+void
+picosat_set_priority (PS * ps, int int_lit, int priority)
+{
+  int old_priority;
+  Lit * lit;
+  Var * v;
+  Rnk * r;
+
+  check_ready (ps);
+
+  lit = import_lit (ps, int_lit, 1);
+  v = LIT2VAR (lit);
+  r = VAR2RNK (v);
+
+  old_priority = r->priority;
+  r->priority = priority;
+
+  if (!r->pos)
+    return;
+
+  if (priority > old_priority)
+    hup (ps, r);
+  else if (priority < old_priority)
+    hdown (ps, r);
+}
+
 #ifndef NADC
 
 unsigned
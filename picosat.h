@@ -123,6 +123,23 @@ void picosat_set_verbosity (PicoSAT *, int new_verbosity_level);
  */
 void picosat_set_global_default_phase (PicoSAT *, int);
 
+/* Run time options of the search, such as 'probe' (failed literal
+ * probing), 'dsc' (detach satisfied clauses), 'luby' (restart schedule),
+ * 'rdecide' (random decision interval) and the restart and reduction
+ * factors.  The compile time switches 'NFL', 'NDSC' and 'NLUBY' only
+ * determine the default values (and in the first two cases whether the
+ * technique can be enabled at all).  Setting an option returns zero if
+ * 'name' is not a valid option or 'value' is out of its range.  Options
+ * can be changed between calls to 'picosat_sat'.  'picosat_copy_options'
+ * copies the values of all options from 'src', and the last function prints
+ * all options with their current values, ranges and descriptions.
+ */
+int picosat_has_option (const char * name);
+int picosat_set_option (PicoSAT *, const char * name, int value);
+int picosat_get_option (PicoSAT *, const char * name);
+void picosat_copy_options (PicoSAT *, PicoSAT * src);
+void picosat_print_options (PicoSAT *, FILE *);
+
 /* Set next/initial phase of a particular variable if picked as decision
  * variable.  Second argument 'phase' has the following meaning:
  *
@@ -139,6 +156,13 @@ void picosat_set_global_default_phase (PicoSAT *, int);
  */
 void picosat_set_default_phase_lit (PicoSAT *, int lit, int phase);
 
+/* Set the default phase of all 'n' literals in 'lits' such that each of
+ * them is assigned to true if picked as decision variable.  This is the
+ * same as calling 'picosat_set_default_phase_lit (lit, 1)' for each of
+ * them and allows to warm start the solver from a previous assignment.
+ */
+void picosat_set_default_phase_lits (PicoSAT *, const int * lits, int n);
+
 /* You can reset all phases by the following function.
  */
 void picosat_reset_phases (PicoSAT *);
@@ -165,6 +189,17 @@ void picosat_remove_learned (PicoSAT *, unsigned percentage);
 void picosat_set_more_important_lit (PicoSAT *, int lit);
 void picosat_set_less_important_lit (PicoSAT *, int lit);
 
+/* Set the branching priority of the variable of 'lit'.  Variables with a
+ * higher priority are always used as decisions before variables with a
+ * lower priority, while scores only order variables of the same priority.
+ * Random decisions (the 'rdecide' option) are also restricted to the
+ * highest importance and priority with unassigned variables.
+ * The default priority is zero, which allows arbitrary many tiers above
+ * and below the default.  Marking variables as more or less important
+ * with the two functions above takes precedence over priorities.
+ */
+void picosat_set_priority (PicoSAT *, int lit, int priority);
+
 /* Allows to print to internal 'out' file from client.
  */
 void picosat_message (PicoSAT *, int verbosity_level, const char * fmt, ...);
@@ -259,6 +294,24 @@ int picosat_pop (PicoSAT *);
  */
 void picosat_simplify (PicoSAT *);
 
+/*------------------------------------------------------------------------*/
+/* Clause groups are an alternative to contexts without stack discipline.
+ * 'picosat_new_group' returns a new group, which is actually an internal
+ * variable as for 'picosat_push' and shares the same restrictions on
+ * new variable indices.  Clauses added after 'picosat_set_group' with this
+ * group (and before setting another group or zero) belong to the group, in
+ * addition to the current context.  Enabled groups (the default) are
+ * assumed in every call to 'picosat_sat', while disabled groups are
+ * ignored.  Deleting a group discards its clauses and all learned clauses
+ * derived from them in the same way as 'picosat_pop' does for contexts.
+ */
+int picosat_new_group (PicoSAT *);
+void picosat_set_group (PicoSAT *, int group);
+void picosat_enable_group (PicoSAT *, int group);
+void picosat_disable_group (PicoSAT *, int group);
+int picosat_group_enabled (PicoSAT *, int group);
+void picosat_delete_group (PicoSAT *, int group);
+
 /*------------------------------------------------------------------------*/
 /* If you know a good estimate on how many variables you are going to use
  * then calling this function before adding literals will result in less
@@ -279,6 +332,7 @@ void picosat_stats (PicoSAT *);                         /* > output file */
 unsigned long long picosat_propagations (PicoSAT *);	/* #propagations */
 unsigned long long picosat_decisions (PicoSAT *);	/* #decisions */
 unsigned long long picosat_visits (PicoSAT *);		/* #visits */
+unsigned long long picosat_conflicts (PicoSAT *);	/* #conflicts */
 
 /* The time spent in the library or in 'picosat_sat'.  The former is only
  * returned if, right after initialization 'picosat_measure_all_calls'
@@ -301,7 +355,9 @@ int picosat_add (PicoSAT *, int lit);
  */
 int picosat_add_arg (PicoSAT *, int lit, ...);
 
-/* As the previous function but with an at compile time unknown size.
+/* As the previous function but with an at compile time unknown size.  The
+ * API checks are done once for the whole clause, which makes this cheaper
+ * than 'picosat_add' for loading many clauses.
  */
 int picosat_add_lits (PicoSAT *, int * lits);
 
@@ -414,6 +470,52 @@ int picosat_sat (PicoSAT *, int decision_limit);
  */
 void picosat_set_propagation_limit (PicoSAT *, unsigned long long limit);
 
+/* Call 'interrupted' with 'external_state' every few hundred decisions of
+ * 'picosat_sat'.  If it returns a non zero value, 'picosat_sat' returns
+ * 'PICOSAT_UNKNOWN' as if a limit had been reached.  This is how time,
+ * conflict or memory limits are implemented by the application.  A NULL
+ * function disables the interrupt.
+ */
+void picosat_set_interrupt (PicoSAT *,
+                            void * external_state,
+                            int (*interrupted)(void * external_state));
+
+/* Assume the literals of the zero terminated array 'lits' and call
+ * 'picosat_sat'.  Unlike separate calls to 'picosat_assume', the decisions
+ * on a common prefix of the assumptions of the previous satisfiable call
+ * (including contexts and groups) are kept instead of being redone.  This
+ * is useful for many queries sorted by their assumptions.
+ */
+int picosat_sat_assuming (PicoSAT *, const int * lits, int decision_limit);
+
+/* Assume the literals of the zero terminated array 'lits' (after contexts,
+ * groups and previous calls to 'picosat_assume') on separate decision
+ * levels and run unit propagation only, without any search.  Afterwards
+ * all levels are backtracked again and the assumptions are reset.  The
+ * result is 'PICOSAT_UNSATISFIABLE' if propagation ran into a conflict and
+ * 'PICOSAT_UNKNOWN' otherwise.  Learned clauses are only derived if the
+ * formula itself propagates to a conflict at the top level.
+ */
+int picosat_propagate (PicoSAT *, const int * lits);
+
+/* Zero terminated list of the literals implied by the last call to
+ * 'picosat_propagate' (not including decisions and top level units), or,
+ * if it returned 'PICOSAT_UNSATISFIABLE', the falsified literals of the
+ * conflicting clause.  A falsified assumption is returned on its own and
+ * an empty list means that the formula is unsatisfiable.
+ */
+const int * picosat_propagated (PicoSAT *);
+
+/* After 'PICOSAT_SATISFIABLE' was returned, this function returns the zero
+ * terminated list of the decisions of the satisfying assignment (in the
+ * order of their decision levels and without the assumptions).  Unit
+ * propagation of the assumptions and these decisions yields the whole
+ * assignment.  Flipping the last decision and assuming the others with
+ * 'picosat_sat_assuming' enumerates all solutions chronologically without
+ * any blocking clauses.
+ */
+const int * picosat_decision_lits (PicoSAT *);
+
 /* Return last result of calling 'picosat_sat' or '0' if not called.
  */
 int picosat_res (PicoSAT *);
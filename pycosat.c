@@ -6,6 +6,32 @@
 */
 
 #include <Python.h>
+#include <pythread.h>
+#include <time.h>
+#include <math.h>
+#include <stddef.h>
+
+#ifdef HAVE_FORK
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#define HAVE_SERVE
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL  0
+#endif
+#endif
 
 #ifdef _MSC_VER
 #define NGETRUSAGE
@@ -28,22 +54,78 @@
 #define IS_INT(x)  (PyInt_Check(x) || PyLong_Check(x))
 #endif
 
+#if PY_VERSION_HEX < 0x03020000
+typedef long Py_hash_t;
+#endif
+
+/* Since Python 3.10 the module uses multi-phase initialization, and its
+   types are heap types which belong to each module object, such that it
+   can be imported in subinterpreters with their own GIL.  Older versions
+   use static types. */
+#if PY_VERSION_HEX >= 0x030A0000
+#define HEAP_TYPES
+#endif
+
+#ifdef HEAP_TYPES
+/* instances of heap types own a reference to their type */
+#define RELEASE_TYPE(tp)  Py_DECREF(tp)
+#else
+#define RELEASE_TYPE(tp)
+#endif
+
+/* The types which are instantiated from C */
+typedef struct {
+    PyTypeObject *SolIter_Type;
+    PyTypeObject *VarMap_Type;
+    PyTypeObject *ClauseGroup_Type;
+    PyTypeObject *DDNNFIter_Type;
+} modulestate;
+
+#ifdef HEAP_TYPES
+static modulestate* module_state(PyObject *module)
+{
+    return (modulestate *) PyModule_GetState(module);
+}
+
+static modulestate* type_state(PyTypeObject *type)
+{
+    return (modulestate *) PyType_GetModuleState(type);
+}
+#else
+static modulestate static_state;
+
+#define module_state(module)  (&static_state)
+#define type_state(type)  (&static_state)
+#endif
+
+/* picosat allocates memory while the GIL is released, which requires the
+   raw memory interface */
+#if PY_VERSION_HEX >= 0x03040000
+#define PicoMem_Malloc   PyMem_RawMalloc
+#define PicoMem_Realloc  PyMem_RawRealloc
+#define PicoMem_Free     PyMem_RawFree
+#else
+#define PicoMem_Malloc   PyMem_Malloc
+#define PicoMem_Realloc  PyMem_Realloc
+#define PicoMem_Free     PyMem_Free
+#endif
+
 
 /* the following three adapter functions are used as arguments to
    picosat_minit, such that picosat used the Python memory manager */
 inline static void *py_malloc(void *mmgr, size_t bytes)
 {
-    return PyMem_Malloc(bytes);
+    return PicoMem_Malloc(bytes);
 }
 
 inline static void *py_realloc(void *mmgr, void *ptr, size_t old, size_t new)
 {
-    return PyMem_Realloc(ptr, new);
+    return PicoMem_Realloc(ptr, new);
 }
 
 inline static void py_free(void *mmgr, void *ptr, size_t bytes)
 {
-    PyMem_Free(ptr);
+    PicoMem_Free(ptr);
 }
 
 /* Add the inverse of the (current) solution to the clauses.
@@ -71,7 +153,43 @@ static int blocksol(PicoSAT *picosat, signed char *mem)
     return 0;
 }
 
-static int add_clause(PicoSAT *picosat, PyObject *clause)
+/* 128 bit hash of a set of clauses, which does not depend on the order of
+   the clauses, or of the literals within a clause.  Each of the two 64 bit
+   lanes is a sum of mixed values, with different mixing for each lane. */
+typedef struct {
+    unsigned long long lo, hi;      /* clauses so far */
+    unsigned long long clo, chi;    /* literals of the current clause */
+} clausehash;
+
+/* the finalizer of splitmix64 */
+static unsigned long long mix64(unsigned long long x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/* Add the literal 'lit' to the hash 'h', where zero ends a clause */
+static void hash_lit(clausehash *h, int lit)
+{
+    unsigned long long x = (unsigned) lit;
+
+    if (lit) {
+        h->clo += mix64(x);
+        h->chi += mix64(x ^ 0x9e3779b97f4a7c15ull);
+    }
+    else {
+        h->lo += mix64(h->clo + 0x632be59bd9b4e019ull);
+        h->hi += mix64(h->chi ^ 0x85157af5d2a9bc3full);
+        h->clo = h->chi = 0;
+    }
+}
+
+/* Add a clause (a list of integers) to picosat, and to the hash 'h' unless
+   it is NULL */
+static int add_clause(PicoSAT *picosat, PyObject *clause, clausehash *h)
 {
     PyObject *lit;              /* the literals are integers */
     Py_ssize_t n, i;
@@ -97,16 +215,27 @@ static int add_clause(PicoSAT *picosat, PyObject *clause)
             return -1;
         }
         picosat_add(picosat, v);
+        if (h)
+            hash_lit(h, v);
     }
     picosat_add(picosat, 0);
+    if (h)
+        hash_lit(h, 0);
     return 0;
 }
 
-static int add_clauses(PicoSAT *picosat, PyObject *clauses)
+static int add_flat_clauses(PicoSAT *picosat, PyObject *clauses,
+                            clausehash *h);
+
+static int add_clauses(PicoSAT *picosat, PyObject *clauses, clausehash *h)
 {
     PyObject *item;             /* each clause is a list of intergers */
     Py_ssize_t n, i;
 
+    /* a ClauseBuffer (or buffer) holds zero terminated clauses */
+    if (PyObject_CheckBuffer(clauses))
+        return add_flat_clauses(picosat, clauses, h);
+
     if (!PyList_Check(clauses)) {
         PyErr_SetString(PyExc_TypeError, "list expected");
         return -1;
@@ -117,26 +246,323 @@ static int add_clauses(PicoSAT *picosat, PyObject *clauses)
         item = PyList_GetItem(clauses, i);
         if (item == NULL)
             return -1;
-        if (add_clause(picosat, item) < 0)
+        if (add_clause(picosat, item, h) < 0)
             return -1;
     }
     return 0;
 }
 
-static PicoSAT* setup_picosat(PyObject *args, PyObject *kwds)
+/* Read the literal stored as item 'i' of a buffer with format 'fmt' */
+static long buffer_item(Py_buffer *view, Py_ssize_t i, char fmt)
 {
-    PicoSAT *picosat;
+    char *p = (char *) view->buf + i * view->itemsize;
+
+    switch (fmt) {
+    case 'b': return *(signed char *) p;
+    case 'h': return *(short *) p;
+    case 'i': return *(int *) p;
+    case 'l': return *(long *) p;
+    case 'q': return (long) *(PY_LONG_LONG *) p;
+    case 'n': return (long) *(Py_ssize_t *) p;
+    }
+    return 0;
+}
+
+/* Convert 'obj' into a newly allocated zero terminated array of literals,
+   which has to be released using PyMem_Free.  'obj' is either a list of integers
+   or an object supporting the buffer protocol with signed integer items,
+   e.g. array.array('i', ...).  Returns the number of literals, or -1 with
+   an exception set. */
+static Py_ssize_t get_lits(PyObject *obj, int **lits)
+{
+    Py_buffer view;
+    PyObject *lit;
+    Py_ssize_t n, i;
+    const char *fmt;
+    long v;
+
+    if (PyList_Check(obj)) {
+        n = PyList_Size(obj);
+        *lits = PyMem_Malloc((n + 1) * sizeof(int));
+        if (*lits == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (i = 0; i < n; i++) {
+            lit = PyList_GET_ITEM(obj, i);
+            if (!IS_INT(lit))  {
+                PyErr_SetString(PyExc_TypeError, "interger expected");
+                goto error;
+            }
+            v = PyLong_AsLong(lit);
+            if (v == -1 && PyErr_Occurred())
+                goto error;
+            if (v == 0 || v > INT_MAX || v < -INT_MAX) {
+                PyErr_SetString(PyExc_ValueError,
+                                "non-zero interger expected");
+                goto error;
+            }
+            (*lits)[i] = (int) v;
+        }
+        (*lits)[n] = 0;
+        return n;
+    }
+
+    if (!PyObject_CheckBuffer(obj)) {
+        PyErr_SetString(PyExc_TypeError, "list or buffer expected");
+        return -1;
+    }
+    if (PyObject_GetBuffer(obj, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+        return -1;
+
+    fmt = view.format ? view.format : "B";
+    if (*fmt == '@' || *fmt == '=')
+        fmt++;
+    if (!*fmt || fmt[1] || !strchr("bhilqn", *fmt)) {
+        PyErr_Format(PyExc_TypeError,
+                     "buffer of signed integers expected, got format '%s'",
+                     view.format ? view.format : "B");
+        PyBuffer_Release(&view);
+        return -1;
+    }
+
+    n = view.len / view.itemsize;
+    *lits = PyMem_Malloc((n + 1) * sizeof(int));
+    if (*lits == NULL) {
+        PyBuffer_Release(&view);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        v = buffer_item(&view, i, *fmt);
+        if (v == 0 || v > INT_MAX || v < -INT_MAX) {
+            PyErr_SetString(PyExc_ValueError, "non-zero interger expected");
+            PyBuffer_Release(&view);
+            goto error;
+        }
+        (*lits)[i] = (int) v;
+    }
+    (*lits)[n] = 0;
+    PyBuffer_Release(&view);
+    return n;
+
+ error:
+    PyMem_Free(*lits);
+    *lits = NULL;
+    return -1;
+}
+
+/* Use the literals in 'phases' (for example a previous solution) as default
+   phases, such that the search starts out trying to satisfy them.  Literals
+   of variables which do not occur in the clauses are ignored, as they would
+   otherwise add variables to the solution. */
+static int set_phases(PicoSAT *picosat, PyObject *phases)
+{
+    Py_ssize_t n, i, k;
+    int *lits, max_idx = picosat_variables(picosat);
+
+    n = get_lits(phases, &lits);
+    if (n < 0)
+        return -1;
+
+    for (i = k = 0; i < n; i++)
+        if (abs(lits[i]) <= max_idx)
+            lits[k++] = lits[i];
+
+    picosat_set_default_phase_lits(picosat, lits, (int) k);
+    PyMem_Free(lits);
+    return 0;
+}
+
+/* Set branching priorities from a dictionary mapping variables (or
+   literals) to integer priorities.  Variables with higher priority are
+   decided first.  As for the phases, variables which do not occur in the
+   clauses are ignored. */
+static int set_priorities(PicoSAT *picosat, PyObject *priorities)
+{
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    long v, prio;
+    int max_idx = picosat_variables(picosat);
+
+    if (!PyDict_Check(priorities)) {
+        PyErr_SetString(PyExc_TypeError, "dict expected");
+        return -1;
+    }
+
+    while (PyDict_Next(priorities, &pos, &key, &value)) {
+        if (!IS_INT(key) || !IS_INT(value)) {
+            PyErr_SetString(PyExc_TypeError, "interger expected");
+            return -1;
+        }
+        v = PyLong_AsLong(key);
+        if (v == -1 && PyErr_Occurred())
+            return -1;
+        if (v == 0 || v > INT_MAX || v < -INT_MAX) {
+            PyErr_SetString(PyExc_ValueError, "non-zero interger expected");
+            return -1;
+        }
+        prio = PyLong_AsLong(value);
+        if (prio == -1 && PyErr_Occurred())
+            return -1;
+        if (prio > INT_MAX || prio < INT_MIN) {
+            PyErr_SetString(PyExc_OverflowError, "priority out of range");
+            return -1;
+        }
+        if (labs(v) <= max_idx)
+            picosat_set_priority(picosat, (int) v, (int) prio);
+    }
+    return 0;
+}
+
+/* Return the name of the keyword argument 'key' as C string */
+static const char *keyword_name(PyObject *key)
+{
+#ifdef IS_PY3K
+    return PyUnicode_AsUTF8(key);
+#else
+    return PyString_AsString(key);
+#endif
+}
+
+/* Move the keyword arguments which are picosat options (see picosat.h)
+   from 'kwds' into a new dictionary '*options', and return the remaining
+   keyword arguments in '*rest', such that they can be parsed as usual.
+   Both are NULL if 'kwds' is NULL. */
+static int split_options(PyObject *kwds, PyObject **rest, PyObject **options)
+{
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    const char *name;
+
+    *rest = *options = NULL;
+    if (kwds == NULL)
+        return 0;
+
+    *rest = PyDict_Copy(kwds);
+    *options = PyDict_New();
+    if (*rest == NULL || *options == NULL)
+        goto error;
+
+    while (PyDict_Next(kwds, &pos, &key, &value)) {
+        name = keyword_name(key);
+        if (name == NULL)
+            goto error;
+        if (!picosat_has_option(name))
+            continue;
+        if (PyDict_SetItem(*options, key, value) < 0 ||
+                PyDict_DelItem(*rest, key) < 0)
+            goto error;
+    }
+    return 0;
+
+ error:
+    Py_XDECREF(*rest);
+    Py_XDECREF(*options);
+    *rest = *options = NULL;
+    return -1;
+}
+
+/* Move the keyword arguments in the NULL terminated list 'names' from
+   'kwds' into a new dictionary '*own', and return the remaining keyword
+   arguments in '*rest', which are passed on to setup_picosat.  Both are
+   NULL if 'kwds' is NULL. */
+static int split_keywords(PyObject *kwds, char **names, PyObject **own,
+                          PyObject **rest)
+{
+    PyObject *value;
+
+    *own = *rest = NULL;
+    if (kwds == NULL)
+        return 0;
+
+    *rest = PyDict_Copy(kwds);
+    *own = PyDict_New();
+    if (*rest == NULL || *own == NULL)
+        goto error;
+
+    for (; *names; names++) {
+        value = PyDict_GetItemString(kwds, *names);
+        if (value == NULL)
+            continue;
+        if (PyDict_SetItemString(*own, *names, value) < 0 ||
+                PyDict_DelItemString(*rest, *names) < 0)
+            goto error;
+    }
+    return 0;
+
+ error:
+    Py_XDECREF(*own);
+    Py_XDECREF(*rest);
+    *own = *rest = NULL;
+    return -1;
+}
+
+/* Set the picosat option 'name' to the integer 'value' */
+static int set_option(PicoSAT *picosat, const char *name, PyObject *value)
+{
+    long v;
+
+    if (!picosat_has_option(name)) {
+        PyErr_Format(PyExc_ValueError, "unknown option '%s'", name);
+        return -1;
+    }
+    if (!IS_INT(value)) {
+        PyErr_SetString(PyExc_TypeError, "interger expected");
+        return -1;
+    }
+    v = PyLong_AsLong(value);
+    if (v == -1 && PyErr_Occurred())
+        return -1;
+    if (v > INT_MAX || v < INT_MIN ||
+            !picosat_set_option(picosat, name, (int) v)) {
+        PyErr_Format(PyExc_ValueError, "invalid value %ld for option '%s'",
+                     v, name);
+        return -1;
+    }
+    return 0;
+}
+
+static int set_options(PicoSAT *picosat, PyObject *options)
+{
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    const char *name;
+
+    while (PyDict_Next(options, &pos, &key, &value)) {
+        name = keyword_name(key);
+        if (name == NULL || set_option(picosat, name, value) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Create and setup a picosat instance from the arguments of solve and
+   itersolve.  If 'plimit' is not NULL the propagation limit is stored in
+   it as well, and if 'hash' is not NULL the clauses are added to it. */
+static PicoSAT* setup_picosat(PyObject *args, PyObject *kwds,
+                              unsigned long long *plimit, clausehash *hash)
+{
+    PicoSAT *picosat = NULL;
+    PyObject *rest, *options;   /* keyword arguments and picosat options */
     PyObject *clauses;          /* list of clauses */
+    PyObject *phases = NULL;    /* literals used as default phases */
+    PyObject *priorities = NULL;  /* dict of branching priorities */
     int vars = -1, verbose = 0;
     unsigned long long prop_limit = 0;
     static char* kwlist[] = {"clauses",
-                             "vars", "verbose", "prop_limit", NULL};
+                             "vars", "verbose", "prop_limit", "phases",
+                             "priorities", NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiK:(iter)solve", kwlist,
-                                     &clauses,
-                                     &vars, &verbose, &prop_limit))
+    if (split_options(kwds, &rest, &options) < 0)
         return NULL;
 
+    if (!PyArg_ParseTupleAndKeywords(args, rest, "O|iiKOO:(iter)solve",
+                                     kwlist, &clauses,
+                                     &vars, &verbose, &prop_limit, &phases,
+                                     &priorities))
+        goto error;
+
     picosat = picosat_minit(NULL, py_malloc, py_realloc, py_free);
     picosat_set_verbosity(picosat, verbose);
     if (vars != -1)
@@ -144,59 +570,72 @@ static PicoSAT* setup_picosat(PyObject *args, PyObject *kwds)
 
     if (prop_limit)
         picosat_set_propagation_limit(picosat, prop_limit);
+    if (plimit)
+        *plimit = prop_limit;
 
-    if (add_clauses(picosat, clauses) < 0) {
-        picosat_reset(picosat);
-        return NULL;
-    }
+    if (options && set_options(picosat, options) < 0)
+        goto error;
+
+    if (add_clauses(picosat, clauses, hash) < 0)
+        goto error;
+
+    if (phases && phases != Py_None && set_phases(picosat, phases) < 0)
+        goto error;
+
+    if (priorities && priorities != Py_None &&
+            set_priorities(picosat, priorities) < 0)
+        goto error;
 
     if (verbose >= 2)
         picosat_print(picosat, stdout);
 
+    Py_XDECREF(rest);
+    Py_XDECREF(options);
     return picosat;
+
+ error:
+    if (picosat)
+        picosat_reset(picosat);
+    Py_XDECREF(rest);
+    Py_XDECREF(options);
+    return NULL;
 }
 
-static PyObject* get_solution(PicoSAT *picosat)
+/* Return the values of the variables 1 to 'max_idx' as list */
+static PyObject* get_solution(PicoSAT *picosat, int max_idx)
 {
     PyObject *list;
-    int max_idx, i, v;
+    int i, v;
 
-    max_idx = picosat_variables(picosat);
     list = PyList_New((Py_ssize_t) max_idx);
-    if (list == NULL) {
-        picosat_reset(picosat);
+    if (list == NULL)
         return NULL;
-    }
     for (i = 1; i <= max_idx; i++) {
         v = picosat_deref(picosat, i);
         assert(v == -1 || v == 1);
         if (PyList_SetItem(list, (Py_ssize_t) (i - 1),
                            PyInt_FromLong((long) (v * i))) < 0) {
             Py_DECREF(list);
-            picosat_reset(picosat);
             return NULL;
         }
     }
     return list;
 }
 
-static PyObject* solve(PyObject *self, PyObject *args, PyObject *kwds)
+/* Run the solver and return the solution (restricted to the variables 1
+   to 'max_idx'), "UNSAT" or "UNKNOWN" */
+static PyObject* run_solve(PicoSAT *picosat, int max_idx)
 {
-    PicoSAT *picosat;
     PyObject *result = NULL;    /* return value */
     int res;
 
-    picosat = setup_picosat(args, kwds);
-    if (picosat == NULL)
-        return NULL;
-
     Py_BEGIN_ALLOW_THREADS      /* release GIL */
     res = picosat_sat(picosat, -1);
     Py_END_ALLOW_THREADS
 
     switch (res) {
     case PICOSAT_SATISFIABLE:
-        result = get_solution(picosat);
+        result = get_solution(picosat, max_idx);
         break;
 
     case PICOSAT_UNSATISFIABLE:
@@ -210,101 +649,6285 @@ static PyObject* solve(PyObject *self, PyObject *args, PyObject *kwds)
     default:
         PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
     }
-
-    picosat_reset(picosat);
     return result;
 }
 
-/*********************** Solution Iterator *********************/
-
+/* Clauses stored in one flat buffer of zero terminated literals, which is
+   used to verify solutions independently of the solver */
 typedef struct {
-    PyObject_HEAD
-    PicoSAT *picosat;
-    signed char *mem;           /* temporary storage */
-} soliterobject;
+    int *lits;
+    Py_ssize_t n, size;         /* used and allocated literals */
+    Py_ssize_t nclauses;
+    int max_idx;                /* largest variable */
+} flatcnf;
 
-static PyTypeObject SolIter_Type;
+static int flat_push(flatcnf *f, int lit)
+{
+    Py_ssize_t size;
+    int *lits;
 
-#define SolIter_Check(op)  PyObject_TypeCheck(op, &SolIter_Type)
+    if (f->n == f->size) {
+        size = 2 * f->size + 64;
+        lits = PyMem_Realloc(f->lits, size * sizeof(int));
+        if (lits == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        f->lits = lits;
+        f->size = size;
+    }
+    f->lits[f->n++] = lit;
+    if (lit == 0)
+        f->nclauses++;
+    else if (abs(lit) > f->max_idx)
+        f->max_idx = abs(lit);
+    return 0;
+}
 
-static PyObject* itersolve(PyObject *self, PyObject *args, PyObject *kwds)
+/* Append the clause 'obj' (a list or buffer of integers) to 'f' */
+static int flat_append(flatcnf *f, PyObject *obj)
 {
-    soliterobject *it;          /* iterator to be returned */
+    Py_ssize_t n, i;
+    int *lits;
 
-    it = PyObject_GC_New(soliterobject, &SolIter_Type);
-    if (it == NULL)
-        return NULL;
+    n = get_lits(obj, &lits);
+    if (n < 0)
+        return -1;
+    for (i = 0; i <= n; i++)
+        if (flat_push(f, i < n ? lits[i] : 0) < 0)
+            break;
+    PyMem_Free(lits);
+    return i <= n ? -1 : 0;
+}
 
-    it->picosat = setup_picosat(args, kwds);
-    if (it->picosat == NULL)
-        return NULL;
+/* Append the zero terminated clauses of the buffer 'obj' (of signed
+   integers, e.g. array.array('i', ...)) to 'f'.  The last clause need not
+   be terminated. */
+static int flat_append_buffer(flatcnf *f, PyObject *obj)
+{
+    Py_buffer view;
+    Py_ssize_t n, i;
+    const char *fmt;
+    long v;
 
-    it->mem = NULL;
-    PyObject_GC_Track(it);
-    return (PyObject *) it;
+    if (PyObject_GetBuffer(obj, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+        return -1;
+    fmt = view.format ? view.format : "B";
+    if (*fmt == '@' || *fmt == '=')
+        fmt++;
+    if (!*fmt || fmt[1] || !strchr("bhilqn", *fmt)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "buffer of signed integers expected");
+        PyBuffer_Release(&view);
+        return -1;
+    }
+    n = view.len / view.itemsize;
+    for (i = 0; i < n; i++) {
+        v = buffer_item(&view, i, *fmt);
+        if (v > INT_MAX || v < -INT_MAX) {
+            PyErr_SetString(PyExc_ValueError, "literal out of range");
+            break;
+        }
+        if (flat_push(f, (int) v) < 0)
+            break;
+    }
+    PyBuffer_Release(&view);
+    if (i < n || (f->n && f->lits[f->n - 1] && flat_push(f, 0) < 0))
+        return -1;
+    return 0;
 }
 
-static PyObject* soliter_next(soliterobject *it)
+/* Append the clauses of the iterable 'obj' to 'f' */
+static int flat_extend(flatcnf *f, PyObject *obj)
 {
-    PyObject *result = NULL;    /* return value */
-    int res;
+    PyObject *iter, *item;
 
-    assert(SolIter_Check(it));
+    iter = PyObject_GetIter(obj);
+    if (iter == NULL)
+        return -1;
+    while ((item = PyIter_Next(iter)) != NULL) {
+        if (flat_append(f, item) < 0) {
+            Py_DECREF(item);
+            Py_DECREF(iter);
+            return -1;
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(iter);
+    return PyErr_Occurred() ? -1 : 0;
+}
 
-    Py_BEGIN_ALLOW_THREADS      /* release GIL */
-    res = picosat_sat(it->picosat, -1);
-    Py_END_ALLOW_THREADS
+/* Read 'obj' into the empty flat buffer 'f'.  'obj' is either an iterable
+   of clauses (lists or buffers of integers, see get_lits), or a single
+   buffer of zero terminated clauses, e.g. array.array('i', ...) or a
+   ClauseBuffer. */
+static int flat_clauses(PyObject *obj, flatcnf *f)
+{
+    f->lits = NULL;
+    f->n = f->size = f->nclauses = 0;
+    f->max_idx = 0;
 
-    switch (res) {
-    case PICOSAT_SATISFIABLE:
-        result = get_solution(it->picosat);
-        if (result == NULL) {
-            PyErr_SetString(PyExc_SystemError, "failed to create list");
-            return NULL;
-        }
-        /* add inverse solution to the clauses,
-           so that next solution can be generated */
-        if (blocksol(it->picosat, it->mem) < 0)
-            return NULL;
-        break;
+    if ((PyObject_CheckBuffer(obj) ? flat_append_buffer(f, obj) :
+                                     flat_extend(f, obj)) < 0) {
+        PyMem_Free(f->lits);
+        f->lits = NULL;
+        return -1;
+    }
+    return 0;
+}
 
-    case PICOSAT_UNSATISFIABLE:
-    case PICOSAT_UNKNOWN:
-        /* no more solutions -- stop iteration */
-        break;
+/* Return the index of the first clause of 'f' which is falsified, or -1.
+   'val' is indexed by literals from -f->max_idx to f->max_idx, and is 1
+   for true literals and 0 otherwise.  The inner loop only accumulates
+   table lookups, such that it runs without branches on the values. */
+static Py_ssize_t first_falsified(const flatcnf *f, const signed char *val)
+{
+    const int *p = f->lits, *eol = f->lits + f->n;
+    Py_ssize_t k;
+    int sat;
 
-    default:
-        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+    for (k = 0; p < eol; k++, p++) {
+        for (sat = 0; *p; p++)
+            sat |= val[*p];
+        if (!sat)
+            return k;
     }
-    return result;
+    return -1;
 }
 
-static void soliter_dealloc(soliterobject *it)
+/* Allocate the table of literal values for 'f' (see first_falsified),
+   which has to be released with PyMem_Free(table - f->max_idx). */
+static signed char* new_values(const flatcnf *f)
 {
-    PyObject_GC_UnTrack(it);
-    if (it->mem)
-        PyMem_Free(it->mem);
-    picosat_reset(it->picosat);
-    PyObject_GC_Del(it);
+    signed char *val;
+
+    val = PyMem_Malloc(2 * (size_t) f->max_idx + 1);
+    if (val == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memset(val, 0, 2 * (size_t) f->max_idx + 1);
+    return val + f->max_idx;
 }
 
-static int soliter_traverse(soliterobject *it, visitproc visit, void *arg)
+/* Check the current solution of 'picosat' against the clauses 'f' */
+static int verify_solution(const flatcnf *f, PicoSAT *picosat)
 {
+    signed char *val;
+    Py_ssize_t k;
+    int max_idx, i;
+
+    val = new_values(f);
+    if (val == NULL)
+        return -1;
+    max_idx = picosat_variables(picosat);
+    if (max_idx > f->max_idx)
+        max_idx = f->max_idx;
+    for (i = 1; i <= max_idx; i++)
+        val[picosat_deref(picosat, i) > 0 ? i : -i] = 1;
+
+    k = first_falsified(f, val);
+    PyMem_Free(val - f->max_idx);
+    if (k >= 0) {
+        PyErr_Format(PyExc_RuntimeError,
+                     "solution falsifies clause %zd", k);
+        return -1;
+    }
     return 0;
 }
 
-static PyTypeObject SolIter_Type = {
-#ifdef IS_PY3K
-    PyVarObject_HEAD_INIT(&SolIter_Type, 0)
-#else
-    PyObject_HEAD_INIT(NULL)
-    0,                                        /* ob_size */
-#endif
-    "soliterator",                            /* tp_name */
-    sizeof(soliterobject),                    /* tp_basicsize */
-    0,                                        /* tp_itemsize */
+/* Return the index of the first clause falsified by the literals in
+   'model' (variables which do not occur in it are false for either
+   phase), or None if the model satisfies all clauses */
+static PyObject* evaluate(PyObject *self, PyObject *args)
+{
+    PyObject *clauses, *model, *result = NULL;
+    signed char *val = NULL;
+    flatcnf f;
+    Py_ssize_t n, i, k;
+    int *lits = NULL;
+
+    if (!PyArg_ParseTuple(args, "OO:evaluate", &clauses, &model))
+        return NULL;
+
+    if (flat_clauses(clauses, &f) < 0)
+        return NULL;
+    n = get_lits(model, &lits);
+    if (n < 0 || (val = new_values(&f)) == NULL)
+        goto done;
+
+    for (i = 0; i < n; i++)
+        if (abs(lits[i]) <= f.max_idx)
+            val[lits[i]] = 1;
+    k = first_falsified(&f, val);
+    if (k < 0) {
+        Py_INCREF(Py_None);
+        result = Py_None;
+    }
+    else
+        result = PyLong_FromSsize_t(k);
+
+ done:
+    if (val)
+        PyMem_Free(val - f.max_idx);
+    PyMem_Free(lits);
+    PyMem_Free(f.lits);
+    return result;
+}
+
+/***************************** Result cache *****************************/
+
+/* A Cache maps the hash of a set of clauses (and the number of variables)
+   to the result of solve, such that repeated calls with the same clauses
+   return without solving.  The entries are kept in a hash table and in a
+   list from the most to the least recently used one, which is evicted
+   when the entries exceed the memory bound. */
+typedef struct cacheentry {
+    unsigned long long lo, hi;      /* hash of the clauses */
+    int nvars;
+    int sat;                        /* solution, or else UNSAT */
+    size_t size;                    /* bytes of this entry */
+    struct cacheentry *chain;       /* next entry of the same bucket */
+    struct cacheentry *newer, *older;
+    unsigned char bits[1];          /* values of the variables (if sat) */
+} cacheentry;
+
+typedef struct {
+    PyObject_HEAD
+    cacheentry **table;
+    size_t mask;                    /* size of the table minus one */
+    Py_ssize_t count;
+    size_t bytes, maxbytes;
+    cacheentry *newest, *oldest;
+    unsigned long long hits, misses, evictions;
+} cacheobject;
+
+static void cache_dealloc(cacheobject *self);
+
+#define Cache_Check(op)  \
+    (Py_TYPE(op)->tp_dealloc == (destructor) cache_dealloc)
+
+static cacheentry** cache_bucket(cacheobject *c, const clausehash *h)
+{
+    return c->table + (size_t) (h->lo & c->mask);
+}
+
+/* Remove the entry 'e' from the table and the list, and free it */
+static void cache_remove(cacheobject *c, cacheentry *e)
+{
+    cacheentry **pe;
+    clausehash h;
+
+    h.lo = e->lo;
+    for (pe = cache_bucket(c, &h); *pe != e; pe = &(*pe)->chain)
+        ;
+    *pe = e->chain;
+    if (e->newer)
+        e->newer->older = e->older;
+    else
+        c->newest = e->older;
+    if (e->older)
+        e->older->newer = e->newer;
+    else
+        c->oldest = e->newer;
+    c->bytes -= e->size;
+    c->count--;
+    PyMem_Free(e);
+}
+
+/* Return the result for the clauses of hash 'h' as new reference (the
+   entry becomes the most recently used one), or NULL */
+static PyObject* cache_lookup(cacheobject *c, const clausehash *h,
+                              int nvars)
+{
+    PyObject *list;
+    cacheentry *e;
+    int i;
+
+    for (e = *cache_bucket(c, h); e; e = e->chain)
+        if (e->lo == h->lo && e->hi == h->hi && e->nvars == nvars)
+            break;
+    if (e == NULL) {
+        c->misses++;
+        return NULL;
+    }
+    c->hits++;
+
+    if (e != c->newest) {
+        e->newer->older = e->older;
+        if (e->older)
+            e->older->newer = e->newer;
+        else
+            c->oldest = e->newer;
+        e->older = c->newest;
+        e->newer = NULL;
+        c->newest->newer = e;
+        c->newest = e;
+    }
+
+    if (!e->sat)
+        return PyUnicode_FromString("UNSAT");
+    list = PyList_New((Py_ssize_t) nvars);
+    if (list == NULL)
+        return NULL;
+    for (i = 1; i <= nvars; i++)
+        PyList_SET_ITEM(list, i - 1, PyInt_FromLong(
+            e->bits[(i - 1) >> 3] & (1 << ((i - 1) & 7)) ? i : -i));
+    return list;
+}
+
+/* Store 'result' (a solution or "UNSAT") of the clauses of hash 'h', and
+   evict the least recently used entries beyond the memory bound */
+static int cache_store(cacheobject *c, const clausehash *h, int nvars,
+                       PyObject *result)
+{
+    cacheentry **table, *e, *next;
+    size_t size, n, k;
+    int i, sat = PyList_Check(result);
+
+    size = offsetof(cacheentry, bits) + (sat ? (nvars + 7) / 8 : 0);
+    if (size > c->maxbytes)
+        return 0;
+
+    if ((size_t) c->count > c->mask) {    /* double the table */
+        n = 2 * (c->mask + 1);
+        table = PyMem_Malloc(n * sizeof(cacheentry *));
+        if (table == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        memset(table, 0, n * sizeof(cacheentry *));
+        for (k = 0; k <= c->mask; k++)
+            for (e = c->table[k]; e; e = next) {
+                next = e->chain;
+                e->chain = table[e->lo & (n - 1)];
+                table[e->lo & (n - 1)] = e;
+            }
+        PyMem_Free(c->table);
+        c->bytes += (n - c->mask - 1) * sizeof(cacheentry *);
+        c->table = table;
+        c->mask = n - 1;
+    }
+
+    e = PyMem_Malloc(size);
+    if (e == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    e->lo = h->lo;
+    e->hi = h->hi;
+    e->nvars = nvars;
+    e->sat = sat;
+    e->size = size;
+    if (sat) {
+        memset(e->bits, 0, (nvars + 7) / 8);
+        for (i = 0; i < nvars; i++)
+            if (PyLong_AsLong(PyList_GET_ITEM(result, i)) > 0)
+                e->bits[i >> 3] |= 1 << (i & 7);
+    }
+    e->chain = *cache_bucket(c, h);
+    *cache_bucket(c, h) = e;
+    e->newer = NULL;
+    e->older = c->newest;
+    if (c->newest)
+        c->newest->newer = e;
+    else
+        c->oldest = e;
+    c->newest = e;
+    c->bytes += size;
+    c->count++;
+
+    while (c->bytes > c->maxbytes && c->oldest != e) {
+        cache_remove(c, c->oldest);
+        c->evictions++;
+    }
+    return 0;
+}
+
+static PyObject* cache_new(PyTypeObject *type, PyObject *args,
+                           PyObject *kwds)
+{
+    cacheobject *self;
+    Py_ssize_t maxbytes = 1 << 24;
+    static char* kwlist[] = {"maxbytes", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n:Cache", kwlist,
+                                     &maxbytes))
+        return NULL;
+
+    if (maxbytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "non-negative maxbytes expected");
+        return NULL;
+    }
+
+    self = (cacheobject *) type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+    self->mask = 15;
+    self->table = PyMem_Malloc((self->mask + 1) * sizeof(cacheentry *));
+    if (self->table == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    memset(self->table, 0, (self->mask + 1) * sizeof(cacheentry *));
+    self->count = 0;
+    self->bytes = (self->mask + 1) * sizeof(cacheentry *);
+    self->maxbytes = (size_t) maxbytes;
+    self->newest = self->oldest = NULL;
+    self->hits = self->misses = self->evictions = 0;
+    return (PyObject *) self;
+}
+
+static PyObject* cache_clear(cacheobject *self)
+{
+    while (self->oldest)
+        cache_remove(self, self->oldest);
+    Py_RETURN_NONE;
+}
+
+static PyObject* cache_stats(cacheobject *self)
+{
+    return Py_BuildValue("{sKsKsKsnsnsn}",
+                         "hits", self->hits,
+                         "misses", self->misses,
+                         "evictions", self->evictions,
+                         "entries", self->count,
+                         "bytes", (Py_ssize_t) self->bytes,
+                         "maxbytes", (Py_ssize_t) self->maxbytes);
+}
+
+static Py_ssize_t cache_length(cacheobject *self)
+{
+    return self->count;
+}
+
+static void cache_dealloc(cacheobject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+
+    if (self->table) {
+        cache_clear(self);
+        PyMem_Free(self->table);
+    }
+    tp->tp_free((PyObject *) self);
+    RELEASE_TYPE(tp);
+}
+
+static PyMethodDef cache_methods[] = {
+    {"stats", (PyCFunction) cache_stats, METH_NOARGS},
+    {"clear", (PyCFunction) cache_clear, METH_NOARGS},
+    {NULL,    NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot cache_slots[] = {
+    {Py_tp_dealloc, cache_dealloc},
+    {Py_tp_methods, cache_methods},
+    {Py_tp_new, cache_new},
+    {Py_sq_length, cache_length},
+    {0, NULL}
+};
+
+static PyType_Spec cache_spec = {
+    "pycosat.Cache", sizeof(cacheobject), 0, Py_TPFLAGS_DEFAULT,
+    cache_slots
+};
+#else
+static PySequenceMethods cache_as_sequence = {
+    (lenfunc) cache_length,                   /* sq_length */
+};
+
+static PyTypeObject Cache_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.Cache",                          /* tp_name */
+    sizeof(cacheobject),                      /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) cache_dealloc,               /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &cache_as_sequence,                       /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    0,                                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    cache_methods,                            /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    cache_new,                                /* tp_new */
+};
+#endif
+
+/* Check the solution 'list' (of run_solve) against the clauses 'f' */
+static int verify_list(const flatcnf *f, PyObject *list)
+{
+    signed char *val;
+    Py_ssize_t k, n;
+    long v;
+
+    val = new_values(f);
+    if (val == NULL)
+        return -1;
+    n = PyList_GET_SIZE(list);
+    for (k = 0; k < n && k < f->max_idx; k++) {
+        v = PyLong_AsLong(PyList_GET_ITEM(list, k));
+        val[v] = 1;
+    }
+    k = first_falsified(f, val);
+    PyMem_Free(val - f->max_idx);
+    if (k >= 0) {
+        PyErr_Format(PyExc_RuntimeError,
+                     "solution falsifies clause %zd", k);
+        return -1;
+    }
+    return 0;
+}
+
+/* Look up the result of the clauses of hash 'h' in 'cache' (if not NULL),
+   or else run the solver and store its result.  A solution is checked
+   against 'f' (if not NULL) before it is returned or stored. */
+static PyObject* run_solve_cached(PicoSAT *picosat, PyObject *cache,
+                                  const clausehash *h, const flatcnf *f)
+{
+    PyObject *result = NULL;
+    int nvars = picosat_variables(picosat), hit = 0;
+
+    if (cache) {
+        result = cache_lookup((cacheobject *) cache, h, nvars);
+        if (result == NULL && PyErr_Occurred())
+            return NULL;
+        hit = result != NULL;
+    }
+    if (!hit)
+        result = run_solve(picosat, nvars);
+    if (result && f && PyList_Check(result) && verify_list(f, result) < 0)
+        Py_CLEAR(result);
+    if (result && cache && !hit && picosat_res(picosat) != PICOSAT_UNKNOWN &&
+            cache_store((cacheobject *) cache, h, nvars, result) < 0)
+        Py_CLEAR(result);
+    return result;
+}
+
+/* Return 0 if 'cache' is a Cache or None (which is replaced by NULL) */
+static int check_cache(PyObject **cache)
+{
+    if (*cache == Py_None)
+        *cache = NULL;
+    if (*cache && !Cache_Check(*cache)) {
+        PyErr_SetString(PyExc_TypeError, "Cache expected");
+        return -1;
+    }
+    return 0;
+}
+
+/**************************** Clause buffer *****************************/
+
+/* A ClauseBuffer stores clauses as zero terminated literals in one
+   growable buffer of C ints, such that large CNFs can be built without a
+   Python list per clause.  It is accepted as clauses everywhere, and
+   exports its literals (read-only) through the buffer protocol. */
+typedef struct {
+    PyObject_HEAD
+    flatcnf cnf;
+    Py_ssize_t shape;           /* number of literals of exported views */
+    int exports;                /* number of exported views */
+} clausebufobject;
+
+static void clausebuf_dealloc(clausebufobject *cb);
+
+/* The types may belong to several modules (see HEAP_TYPES), so objects are
+   recognized by their deallocator */
+#define ClauseBuffer_Check(op)  \
+    (Py_TYPE(op)->tp_dealloc == (destructor) clausebuf_dealloc)
+
+/* The buffer can not grow while views of it are exported */
+static int clausebuf_check_exports(clausebufobject *cb)
+{
+    if (cb->exports > 0) {
+        PyErr_SetString(PyExc_BufferError,
+                        "cannot modify ClauseBuffer while it is exported");
+        return -1;
+    }
+    return 0;
+}
+
+/* Remove the clauses added since 'saved' after an error, such that no
+   partial clauses are left behind */
+static void clausebuf_restore(clausebufobject *cb, const flatcnf *saved)
+{
+    cb->cnf.n = saved->n;
+    cb->cnf.nclauses = saved->nclauses;
+    cb->cnf.max_idx = saved->max_idx;
+}
+
+static PyObject* clausebuf_add(clausebufobject *cb, PyObject *clause)
+{
+    flatcnf saved = cb->cnf;
+
+    if (clausebuf_check_exports(cb) < 0)
+        return NULL;
+    if (flat_append(&cb->cnf, clause) < 0) {
+        clausebuf_restore(cb, &saved);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* clausebuf_extend(clausebufobject *cb, PyObject *clauses)
+{
+    flatcnf saved = cb->cnf;
+
+    if (clausebuf_check_exports(cb) < 0)
+        return NULL;
+    if (flat_extend(&cb->cnf, clauses) < 0) {
+        clausebuf_restore(cb, &saved);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* clausebuf_add_many(clausebufobject *cb, PyObject *buffer)
+{
+    flatcnf saved = cb->cnf;
+
+    if (clausebuf_check_exports(cb) < 0)
+        return NULL;
+    if (flat_append_buffer(&cb->cnf, buffer) < 0) {
+        clausebuf_restore(cb, &saved);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/* Return the clauses of 'f' as list of lists */
+static PyObject* flat_tolist(const flatcnf *f)
+{
+    PyObject *list, *clause, *lit;
+    const int *p = f->lits, *q;
+    Py_ssize_t k, i;
+
+    list = PyList_New(f->nclauses);
+    if (list == NULL)
+        return NULL;
+    for (k = 0; k < f->nclauses; k++, p = q + 1) {
+        for (q = p; *q; q++)
+            ;
+        clause = PyList_New(q - p);
+        if (clause == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, k, clause);
+        for (i = 0; i < q - p; i++) {
+            lit = PyInt_FromLong((long) p[i]);
+            if (lit == NULL) {
+                Py_DECREF(list);
+                return NULL;
+            }
+            PyList_SET_ITEM(clause, i, lit);
+        }
+    }
+    return list;
+}
+
+/* Export the literals of 'f' (owned by 'obj') as read-only buffer of C
+   ints.  'shape' has to stay valid as long as the view is exported. */
+static int flat_getbuffer(PyObject *obj, const flatcnf *f,
+                          Py_ssize_t *shape, Py_buffer *view, int flags)
+{
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "clauses are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    *shape = f->n;
+    view->obj = obj;
+    Py_INCREF(obj);
+    view->buf = f->lits;
+    view->len = f->n * sizeof(int);
+    view->readonly = 1;
+    view->itemsize = sizeof(int);
+    view->format = (flags & PyBUF_FORMAT) ? "i" : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? shape : NULL;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ?
+                    &view->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyObject* clausebuf_tolist(clausebufobject *cb)
+{
+    return flat_tolist(&cb->cnf);
+}
+
+static PyObject* clausebuf_nvars(clausebufobject *cb, void *closure)
+{
+    return PyInt_FromLong((long) cb->cnf.max_idx);
+}
+
+static PyObject* clausebuf_nlits(clausebufobject *cb, void *closure)
+{
+    return PyLong_FromSsize_t(cb->cnf.n - cb->cnf.nclauses);
+}
+
+static Py_ssize_t clausebuf_length(clausebufobject *cb)
+{
+    return cb->cnf.nclauses;
+}
+
+static int clausebuf_getbuffer(clausebufobject *cb, Py_buffer *view,
+                               int flags)
+{
+    if (flat_getbuffer((PyObject *) cb, &cb->cnf, &cb->shape, view,
+                       flags) < 0)
+        return -1;
+    cb->exports++;
+    return 0;
+}
+
+static void clausebuf_releasebuffer(clausebufobject *cb, Py_buffer *view)
+{
+    cb->exports--;
+}
+
+static PyObject* clausebuf_new(PyTypeObject *type, PyObject *args,
+                               PyObject *kwds)
+{
+    clausebufobject *cb;
+    PyObject *clauses = NULL;
+    static char* kwlist[] = {"clauses", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:ClauseBuffer", kwlist,
+                                     &clauses))
+        return NULL;
+
+    cb = (clausebufobject *) type->tp_alloc(type, 0);
+    if (cb == NULL)
+        return NULL;
+    cb->cnf.lits = NULL;
+    cb->cnf.n = cb->cnf.size = cb->cnf.nclauses = 0;
+    cb->cnf.max_idx = 0;
+    cb->shape = 0;
+    cb->exports = 0;
+    /* exported views always point to allocated memory */
+    if (flat_push(&cb->cnf, 0) < 0) {
+        Py_DECREF(cb);
+        return NULL;
+    }
+    cb->cnf.n = cb->cnf.nclauses = 0;
+
+    if (clauses && clauses != Py_None &&
+            (PyObject_CheckBuffer(clauses) ?
+             flat_append_buffer(&cb->cnf, clauses) :
+             flat_extend(&cb->cnf, clauses)) < 0) {
+        Py_DECREF(cb);
+        return NULL;
+    }
+    return (PyObject *) cb;
+}
+
+static void clausebuf_dealloc(clausebufobject *cb)
+{
+    PyTypeObject *tp = Py_TYPE(cb);
+
+    PyMem_Free(cb->cnf.lits);
+    tp->tp_free((PyObject *) cb);
+    RELEASE_TYPE(tp);
+}
+
+static PyMethodDef clausebuf_methods[] = {
+    {"add",         (PyCFunction) clausebuf_add,      METH_O},
+    {"extend",      (PyCFunction) clausebuf_extend,   METH_O},
+    {"add_many",    (PyCFunction) clausebuf_add_many, METH_O},
+    {"tolist",      (PyCFunction) clausebuf_tolist,   METH_NOARGS},
+    {NULL,          NULL}  /* sentinel */
+};
+
+static PyGetSetDef clausebuf_getset[] = {
+    {"nvars", (getter) clausebuf_nvars, NULL, NULL, NULL},
+    {"nlits", (getter) clausebuf_nlits, NULL, NULL, NULL},
+    {NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot clausebuf_slots[] = {
+    {Py_tp_dealloc, clausebuf_dealloc},
+    {Py_tp_methods, clausebuf_methods},
+    {Py_tp_getset, clausebuf_getset},
+    {Py_tp_new, clausebuf_new},
+    {Py_sq_length, clausebuf_length},
+    {Py_bf_getbuffer, clausebuf_getbuffer},
+    {Py_bf_releasebuffer, clausebuf_releasebuffer},
+    {0, NULL}
+};
+
+static PyType_Spec clausebuf_spec = {
+    "pycosat.ClauseBuffer", sizeof(clausebufobject), 0,
+    Py_TPFLAGS_DEFAULT, clausebuf_slots
+};
+#else
+static PySequenceMethods clausebuf_as_sequence = {
+    (lenfunc) clausebuf_length,               /* sq_length */
+};
+
+static PyBufferProcs clausebuf_as_buffer = {
+#ifndef IS_PY3K
+    0,                                        /* bf_getreadbuffer */
+    0,                                        /* bf_getwritebuffer */
+    0,                                        /* bf_getsegcount */
+    0,                                        /* bf_getcharbuffer */
+#endif
+    (getbufferproc) clausebuf_getbuffer,      /* bf_getbuffer */
+    (releasebufferproc) clausebuf_releasebuffer, /* bf_releasebuffer */
+};
+
+static PyTypeObject ClauseBuffer_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.ClauseBuffer",                   /* tp_name */
+    sizeof(clausebufobject),                  /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) clausebuf_dealloc,           /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &clausebuf_as_sequence,                   /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    &clausebuf_as_buffer,                     /* tp_as_buffer */
+#ifdef IS_PY3K
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+#else
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+#endif
+    0,                                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    clausebuf_methods,                        /* tp_methods */
+    0,                                        /* tp_members */
+    clausebuf_getset,                         /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    clausebuf_new,                            /* tp_new */
+};
+#endif
+
+/****************************** CNF object ******************************/
+
+/* A CNF holds clauses which were converted and simplified once: the
+   literals of each clause are sorted and duplicates removed, tautologies
+   and duplicate clauses are dropped, and the units are propagated, such
+   that the remaining clauses neither contain fixed literals nor are
+   satisfied by them.  The units themselves are kept as the first clauses.
+   The clauses are stored like in a ClauseBuffer, but can not be modified,
+   which allows to load them into new solvers without any conversion. */
+typedef struct {
+    PyObject_HEAD
+    flatcnf cnf;
+    Py_ssize_t shape;           /* number of literals of exported views */
+} cnfobject;
+
+static void cnf_dealloc(cnfobject *self);
+
+#define CNF_Check(op)  (Py_TYPE(op)->tp_dealloc == (destructor) cnf_dealloc)
+
+static int cmp_lits(const void *p, const void *q)
+{
+    int a = *(const int *) p, b = *(const int *) q;
+
+    if (abs(a) != abs(b))
+        return abs(a) < abs(b) ? -1 : 1;
+    return (a > b) - (a < b);
+}
+
+/* Clauses (zero terminated and sorted) are compared by size first */
+static int cmp_clauses(const void *p, const void *q)
+{
+    const int *a = *(const int * const *) p, *b = *(const int * const *) q;
+    Py_ssize_t i, n, m;
+
+    for (n = 0; a[n]; n++)
+        ;
+    for (m = 0; b[m]; m++)
+        ;
+    if (n != m)
+        return n < m ? -1 : 1;
+    for (i = 0; i < n; i++)
+        if (a[i] != b[i])
+            return cmp_lits(a + i, b + i);
+    return 0;
+}
+
+/* Sort the literals of each clause of 'f' in place.  Duplicate literals,
+   and all literals of tautologies, are replaced by INT_MIN. */
+static void sort_clauses(flatcnf *f)
+{
+    int *p, *q, *r, last, *eol = f->lits + f->n;
+
+    for (p = f->lits; p < eol; p = q + 1) {
+        for (q = p; *q; q++)
+            ;
+        qsort(p, q - p, sizeof(int), cmp_lits);
+        for (r = p + 1; r < q; r++)
+            if (abs(*r) == abs(r[-1]) && *r != r[-1])
+                break;
+        if (r < q) {
+            /* tautology: keep the clause boundary only */
+            for (r = p; r < q; r++)
+                *r = INT_MIN;
+            continue;
+        }
+        /* compare with the last literal kept (not with a replaced one) */
+        for (last = *p, r = p + 1; r < q; r++) {
+            if (*r == last)
+                *r = INT_MIN;
+            else
+                last = *r;
+        }
+    }
+}
+
+/* Simplify the clauses 'f' (see above) into the new flat buffer 'out' */
+static int simplify_clauses(flatcnf *f, flatcnf *out)
+{
+    signed char *val = NULL;    /* values of variables */
+    Py_ssize_t *start = NULL, *occs = NULL, *noccs = NULL, *cnt = NULL;
+    Py_ssize_t nclauses = 0, i, j, k, c;
+    int *trail = NULL, ntrail = 0, next, lit, *p, *q, *eol;
+    char *sat = NULL;
+    int **order = NULL;
+    int unsat = 0, max_idx = f->max_idx, res = -1;
+
+    out->lits = NULL;
+    out->n = out->size = out->nclauses = 0;
+    out->max_idx = 0;
+
+    sort_clauses(f);
+    eol = f->lits + f->n;
+
+    /* the clauses, and the clauses of each literal (occs, from noccs[lit]
+       to noccs[lit + 1] with literals mapped to 0 .. 2 max_idx + 1) */
+    val = PyMem_Malloc(max_idx + 1);
+    trail = PyMem_Malloc((max_idx + 1) * sizeof(int));
+    start = PyMem_Malloc((f->nclauses + 1) * sizeof(Py_ssize_t));
+    noccs = PyMem_Malloc((2 * (size_t) max_idx + 3) * sizeof(Py_ssize_t));
+    occs = PyMem_Malloc((f->n + 1) * sizeof(Py_ssize_t));
+    cnt = PyMem_Malloc((f->nclauses + 1) * sizeof(Py_ssize_t));
+    sat = PyMem_Malloc(f->nclauses + 1);
+    order = PyMem_Malloc((f->nclauses + 1) * sizeof(int *));
+    if (!val || !trail || !start || !noccs || !occs || !cnt || !sat ||
+            !order) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    memset(val, 0, max_idx + 1);
+    memset(noccs, 0, (2 * (size_t) max_idx + 3) * sizeof(Py_ssize_t));
+
+#define LITIDX(lit)  (2 * abs(lit) + ((lit) < 0))
+    for (p = f->lits; p < eol; p = q + 1) {
+        start[nclauses] = p - f->lits;
+        cnt[nclauses] = 0;
+        sat[nclauses] = 0;
+        for (q = p; *q; q++)
+            if (*q != INT_MIN) {
+                noccs[LITIDX(*q)]++;
+                cnt[nclauses]++;
+            }
+        if (q > p && cnt[nclauses] == 0)
+            sat[nclauses] = 1;          /* tautology */
+        nclauses++;
+    }
+    for (k = 0, i = 0; i < 2 * (Py_ssize_t) max_idx + 2; i++) {
+        j = noccs[i];
+        noccs[i] = k;
+        k += j;
+    }
+    noccs[2 * max_idx + 2] = k;
+    for (c = 0; c < nclauses; c++) {
+        if (sat[c])
+            continue;
+        for (p = f->lits + start[c]; *p; p++)
+            if (*p != INT_MIN)
+                occs[noccs[LITIDX(*p)]++] = c;
+    }
+    for (i = 2 * max_idx + 1; i > 0; i--)
+        noccs[i] = noccs[i - 1];
+    noccs[0] = 0;
+
+    /* propagate the units, counting the unassigned literals of each
+       clause, and finding the remaining literal of clauses with one */
+    for (c = 0; c < nclauses && !unsat; c++) {
+        if (sat[c] || cnt[c] > 1)
+            continue;
+        if (cnt[c] == 0) {
+            unsat = 1;
+            break;
+        }
+        for (p = f->lits + start[c]; *p == INT_MIN; p++)
+            ;
+        lit = *p;
+        if (val[abs(lit)] == (lit > 0 ? -1 : 1))
+            unsat = 1;
+        else if (!val[abs(lit)]) {
+            val[abs(lit)] = lit > 0 ? 1 : -1;
+            trail[ntrail++] = lit;
+        }
+    }
+    for (next = 0; next < ntrail && !unsat; next++) {
+        lit = trail[next];
+        for (i = noccs[LITIDX(lit)]; i < noccs[LITIDX(lit) + 1]; i++)
+            sat[occs[i]] = 1;
+        for (i = noccs[LITIDX(-lit)]; i < noccs[LITIDX(-lit) + 1]; i++) {
+            c = occs[i];
+            if (sat[c] || --cnt[c] > 1)
+                continue;
+            if (cnt[c] == 0) {
+                unsat = 1;
+                break;
+            }
+            /* the remaining literal, which may be true already */
+            for (p = f->lits + start[c]; *p == INT_MIN || (*p &&
+                     val[abs(*p)] == (*p > 0 ? -1 : 1)); p++)
+                ;
+            if (*p == 0) {
+                unsat = 1;
+                break;
+            }
+            if (!val[abs(*p)]) {
+                val[abs(*p)] = *p > 0 ? 1 : -1;
+                trail[ntrail++] = *p;
+            }
+        }
+    }
+#undef LITIDX
+
+    if (unsat) {
+        if (flat_push(out, 0) < 0)
+            goto done;
+        res = 0;
+        goto done;
+    }
+
+    /* the units first (by variable), then the remaining clauses, with
+       the false literals removed, sorted and without duplicates */
+    qsort(trail, ntrail, sizeof(int), cmp_lits);
+    for (i = 0; i < ntrail; i++)
+        if (flat_push(out, trail[i]) < 0 || flat_push(out, 0) < 0)
+            goto done;
+
+    k = 0;
+    for (c = 0; c < nclauses; c++) {
+        if (sat[c])
+            continue;
+        /* compact the clause in place, such that it can be compared */
+        for (p = q = f->lits + start[c]; *p; p++)
+            if (*p != INT_MIN && !val[abs(*p)])
+                *q++ = *p;
+        *q = 0;
+        order[k++] = f->lits + start[c];
+    }
+    qsort(order, k, sizeof(int *), cmp_clauses);
+    for (i = 0; i < k; i++) {
+        if (i > 0 && cmp_clauses(order + i - 1, order + i) == 0)
+            continue;
+        for (p = order[i]; *p; p++)
+            if (flat_push(out, *p) < 0)
+                goto done;
+        if (flat_push(out, 0) < 0)
+            goto done;
+    }
+    res = 0;
+
+ done:
+    PyMem_Free(val);
+    PyMem_Free(trail);
+    PyMem_Free(start);
+    PyMem_Free(noccs);
+    PyMem_Free(occs);
+    PyMem_Free(cnt);
+    PyMem_Free(sat);
+    PyMem_Free(order);
+    if (res < 0) {
+        PyMem_Free(out->lits);
+        out->lits = NULL;
+    }
+    /* the variables of dropped clauses are still variables of the CNF */
+    out->max_idx = max_idx;
+    return res;
+}
+
+static PyObject* cnf_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    cnfobject *self;
+    PyObject *clauses;
+    flatcnf f;
+    static char* kwlist[] = {"clauses", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:CNF", kwlist, &clauses))
+        return NULL;
+
+    if (flat_clauses(clauses, &f) < 0)
+        return NULL;
+    self = (cnfobject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        PyMem_Free(f.lits);
+        return NULL;
+    }
+    self->shape = 0;
+    if (simplify_clauses(&f, &self->cnf) < 0) {
+        PyMem_Free(f.lits);
+        Py_DECREF(self);
+        return NULL;
+    }
+    PyMem_Free(f.lits);
+    /* exported views always point to allocated memory */
+    if (self->cnf.lits == NULL) {
+        if (flat_push(&self->cnf, 0) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
+        self->cnf.n = self->cnf.nclauses = 0;
+    }
+    return (PyObject *) self;
+}
+
+static void cnf_dealloc(cnfobject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+
+    PyMem_Free(self->cnf.lits);
+    tp->tp_free((PyObject *) self);
+    RELEASE_TYPE(tp);
+}
+
+/* Solve the clauses together with the clauses 'extra' in a new solver,
+   which takes the same keyword arguments as solve */
+static PyObject* cnf_solve(cnfobject *self, PyObject *args, PyObject *kwds)
+{
+    PicoSAT *picosat;
+    PyObject *extra = NULL, *cache = NULL, *own, *rest, *setup_args;
+    PyObject *result = NULL;
+    clausehash h = {0, 0, 0, 0};
+    static char* kwlist[] = {"extra", "cache", NULL};
+
+    if (split_keywords(kwds, kwlist, &own, &rest) < 0)
+        return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, own, "|OO:solve", kwlist,
+                                     &extra, &cache) ||
+            check_cache(&cache) < 0)
+        goto done;
+
+    setup_args = PyTuple_Pack(1, (PyObject *) self);
+    if (setup_args == NULL)
+        goto done;
+    picosat = setup_picosat(setup_args, rest, NULL, cache ? &h : NULL);
+    Py_DECREF(setup_args);
+    if (picosat == NULL)
+        goto done;
+
+    if (extra == NULL || extra == Py_None ||
+            add_clauses(picosat, extra, cache ? &h : NULL) == 0)
+        result = run_solve_cached(picosat, cache, &h, NULL);
+    picosat_reset(picosat);
+
+ done:
+    Py_XDECREF(own);
+    Py_XDECREF(rest);
+    return result;
+}
+
+static PyObject* cnf_tolist(cnfobject *self)
+{
+    return flat_tolist(&self->cnf);
+}
+
+static PyObject* cnf_nvars(cnfobject *self, void *closure)
+{
+    return PyInt_FromLong((long) self->cnf.max_idx);
+}
+
+static Py_ssize_t cnf_length(cnfobject *self)
+{
+    return self->cnf.nclauses;
+}
+
+/* The clauses never change, so any number of views can be exported */
+static int cnf_getbuffer(cnfobject *self, Py_buffer *view, int flags)
+{
+    return flat_getbuffer((PyObject *) self, &self->cnf, &self->shape, view,
+                          flags);
+}
+
+/* Return the clauses of a ClauseBuffer or CNF, or NULL for other objects */
+static const flatcnf* get_flatcnf(PyObject *obj)
+{
+    if (ClauseBuffer_Check(obj))
+        return &((clausebufobject *) obj)->cnf;
+    if (CNF_Check(obj))
+        return &((cnfobject *) obj)->cnf;
+    return NULL;
+}
+
+/* Add the clauses of a ClauseBuffer or CNF, or of a buffer of zero
+   terminated clauses, to 'picosat', one clause at a time using
+   picosat_add_lits.  The variables are allocated beforehand. */
+static int add_flat_clauses(PicoSAT *picosat, PyObject *clauses,
+                            clausehash *h)
+{
+    const flatcnf *cnf;
+    flatcnf f;
+    const int *p, *eol;
+
+    cnf = get_flatcnf(clauses);
+    if (cnf == NULL) {
+        if (flat_clauses(clauses, &f) < 0)
+            return -1;
+        cnf = &f;
+    }
+    if (cnf->max_idx > picosat_variables(picosat))
+        picosat_adjust(picosat, cnf->max_idx);
+    for (p = cnf->lits, eol = p + cnf->n; p < eol; p++) {
+        picosat_add_lits(picosat, (int *) p);
+        if (h)
+            for (;; p++) {
+                hash_lit(h, *p);
+                if (*p == 0)
+                    break;
+            }
+        else
+            while (*p)
+                p++;
+    }
+    if (cnf == &f)
+        PyMem_Free(f.lits);
+    return 0;
+}
+
+static PyMethodDef cnf_methods[] = {
+    {"solve",       (PyCFunction) cnf_solve,          METH_VARARGS |
+                                                      METH_KEYWORDS},
+    {"tolist",      (PyCFunction) cnf_tolist,         METH_NOARGS},
+    {NULL,          NULL}  /* sentinel */
+};
+
+static PyGetSetDef cnf_getset[] = {
+    {"nvars", (getter) cnf_nvars, NULL, NULL, NULL},
+    {NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot cnf_slots[] = {
+    {Py_tp_dealloc, cnf_dealloc},
+    {Py_tp_methods, cnf_methods},
+    {Py_tp_getset, cnf_getset},
+    {Py_tp_new, cnf_new},
+    {Py_sq_length, cnf_length},
+    {Py_bf_getbuffer, cnf_getbuffer},
+    {0, NULL}
+};
+
+static PyType_Spec cnf_spec = {
+    "pycosat.CNF", sizeof(cnfobject), 0,
+    Py_TPFLAGS_DEFAULT, cnf_slots
+};
+#else
+static PySequenceMethods cnf_as_sequence = {
+    (lenfunc) cnf_length,                     /* sq_length */
+};
+
+static PyBufferProcs cnf_as_buffer = {
+#ifndef IS_PY3K
+    0,                                        /* bf_getreadbuffer */
+    0,                                        /* bf_getwritebuffer */
+    0,                                        /* bf_getsegcount */
+    0,                                        /* bf_getcharbuffer */
+#endif
+    (getbufferproc) cnf_getbuffer,            /* bf_getbuffer */
+    0,                                        /* bf_releasebuffer */
+};
+
+static PyTypeObject CNF_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.CNF",                            /* tp_name */
+    sizeof(cnfobject),                        /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) cnf_dealloc,                 /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &cnf_as_sequence,                         /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    &cnf_as_buffer,                           /* tp_as_buffer */
+#ifdef IS_PY3K
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+#else
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+#endif
+    0,                                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    cnf_methods,                              /* tp_methods */
+    0,                                        /* tp_members */
+    cnf_getset,                               /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    cnf_new,                                  /* tp_new */
+};
+#endif
+
+
+static PyObject* solve(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PicoSAT *picosat;
+    PyObject *result;           /* return value */
+    PyObject *own, *rest, *empty, *cache = NULL;
+    flatcnf f;                  /* clauses for verification */
+    clausehash h = {0, 0, 0, 0};
+    int verify = 0;
+    static char* kwlist[] = {"verify", "cache", NULL};
+
+    /* the keyword arguments verify and cache are not passed on to
+       setup_picosat */
+    if (split_keywords(kwds, kwlist, &own, &rest) < 0)
+        return NULL;
+    picosat = NULL;
+    f.lits = NULL;
+    empty = PyTuple_New(0);
+    if (empty && PyArg_ParseTupleAndKeywords(empty, own, "|iO:solve",
+                                             kwlist, &verify, &cache) &&
+            check_cache(&cache) == 0 &&
+            (!verify || PyTuple_GET_SIZE(args) == 0 ||
+             flat_clauses(PyTuple_GET_ITEM(args, 0), &f) == 0))
+        picosat = setup_picosat(args, rest, NULL, cache ? &h : NULL);
+    Py_XDECREF(empty);
+    Py_XDECREF(own);
+    Py_XDECREF(rest);
+    if (picosat == NULL) {
+        PyMem_Free(f.lits);
+        return NULL;
+    }
+
+    result = run_solve_cached(picosat, cache, &h, verify ? &f : NULL);
+    picosat_reset(picosat);
+    PyMem_Free(f.lits);
+    return result;
+}
+
+/*********************** Solution Iterator *********************/
+
+typedef struct {
+    PyObject_HEAD
+    PicoSAT *picosat;
+    signed char *mem;           /* temporary storage */
+    int blocking;               /* block solutions by adding clauses */
+    int *stack, nstack;         /* decisions (zero terminated) */
+    signed char *flipped;       /* decisions which have been flipped */
+    int done;
+    int verify;                 /* check each solution against 'cnf' */
+    flatcnf cnf;
+} soliterobject;
+
+static void soliter_dealloc(soliterobject *it);
+
+#define SolIter_Check(op)  \
+    (Py_TYPE(op)->tp_dealloc == (destructor) soliter_dealloc)
+
+static PyObject* itersolve(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    soliterobject *it;          /* iterator to be returned */
+    PicoSAT *picosat;
+    PyObject *own, *rest, *empty;
+    flatcnf f;                  /* clauses for verification */
+    int blocking = 1, verify = 0, nvars;
+    static char* kwlist[] = {"blocking", "verify", NULL};
+
+    /* the keyword arguments blocking and verify are not passed on to
+       setup_picosat */
+    if (split_keywords(kwds, kwlist, &own, &rest) < 0)
+        return NULL;
+    picosat = NULL;
+    f.lits = NULL;
+    empty = PyTuple_New(0);
+    if (empty && PyArg_ParseTupleAndKeywords(empty, own, "|ii:itersolve",
+                                             kwlist, &blocking, &verify) &&
+            (!verify || PyTuple_GET_SIZE(args) == 0 ||
+             flat_clauses(PyTuple_GET_ITEM(args, 0), &f) == 0))
+        picosat = setup_picosat(args, rest, NULL, NULL);
+    Py_XDECREF(empty);
+    Py_XDECREF(own);
+    Py_XDECREF(rest);
+    if (picosat == NULL) {
+        PyMem_Free(f.lits);
+        return NULL;
+    }
+
+    it = PyObject_GC_New(soliterobject, module_state(self)->SolIter_Type);
+    if (it == NULL) {
+        PyMem_Free(f.lits);
+        picosat_reset(picosat);
+        return NULL;
+    }
+
+    it->picosat = picosat;
+    it->verify = verify;
+    it->cnf = f;
+
+    it->mem = NULL;
+    it->blocking = blocking;
+    it->stack = NULL;
+    it->nstack = 0;
+    it->flipped = NULL;
+    it->done = 0;
+    if (!blocking) {
+        nvars = picosat_variables(picosat);
+        it->stack = PyMem_Malloc((nvars + 1) * sizeof(int));
+        it->flipped = PyMem_Malloc(nvars + 1);
+        if (it->stack == NULL || it->flipped == NULL) {
+            PyTypeObject *tp = Py_TYPE(it);
+
+            PyObject_GC_Del(it);
+            RELEASE_TYPE(tp);
+            PyMem_Free(f.lits);
+            picosat_reset(picosat);
+            return PyErr_NoMemory();
+        }
+        it->stack[0] = 0;
+    }
+    PyObject_GC_Track(it);
+    return (PyObject *) it;
+}
+
+/* Flip the last decision which has not been flipped yet, or set 'done' if
+   there is none left.  Since the last decisions imply the current solution
+   (with the previous ones), the flipped decisions partition the remaining
+   solutions, and no blocking clauses are needed. */
+static void soliter_backtrack(soliterobject *it)
+{
+    while (it->nstack > 0 && it->flipped[it->nstack - 1])
+        it->nstack--;
+    if (it->nstack == 0) {
+        it->done = 1;
+        return;
+    }
+    it->stack[it->nstack - 1] = -it->stack[it->nstack - 1];
+    it->flipped[it->nstack - 1] = 1;
+    it->stack[it->nstack] = 0;
+}
+
+/* Next solution of the chronological enumeration, without blocking clauses */
+static PyObject* soliter_next_chrono(soliterobject *it)
+{
+    PyObject *result = NULL;
+    const int *p;
+    int res;
+
+    while (!it->done) {
+        Py_BEGIN_ALLOW_THREADS      /* release GIL */
+        res = picosat_sat_assuming(it->picosat, it->stack, -1);
+        Py_END_ALLOW_THREADS
+
+        if (res == PICOSAT_UNSATISFIABLE) {
+            soliter_backtrack(it);
+            continue;
+        }
+        if (res != PICOSAT_SATISFIABLE) {
+            it->done = 1;
+            break;
+        }
+        result = get_solution(it->picosat, picosat_variables(it->picosat));
+        if (result == NULL)
+            return NULL;
+        if (it->verify && verify_solution(&it->cnf, it->picosat) < 0) {
+            Py_DECREF(result);
+            return NULL;
+        }
+        for (p = picosat_decision_lits(it->picosat); *p; p++) {
+            it->flipped[it->nstack] = 0;
+            it->stack[it->nstack++] = *p;
+        }
+        soliter_backtrack(it);
+        break;
+    }
+    return result;
+}
+
+static PyObject* soliter_next(soliterobject *it)
+{
+    PyObject *result = NULL;    /* return value */
+    int res;
+
+    assert(SolIter_Check(it));
+
+    if (!it->blocking)
+        return soliter_next_chrono(it);
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    res = picosat_sat(it->picosat, -1);
+    Py_END_ALLOW_THREADS
+
+    switch (res) {
+    case PICOSAT_SATISFIABLE:
+        result = get_solution(it->picosat, picosat_variables(it->picosat));
+        if (result == NULL) {
+            PyErr_SetString(PyExc_SystemError, "failed to create list");
+            return NULL;
+        }
+        if (it->verify && verify_solution(&it->cnf, it->picosat) < 0) {
+            Py_DECREF(result);
+            return NULL;
+        }
+        /* add inverse solution to the clauses,
+           so that next solution can be generated */
+        if (blocksol(it->picosat, it->mem) < 0) {
+            Py_DECREF(result);
+            return NULL;
+        }
+        break;
+
+    case PICOSAT_UNSATISFIABLE:
+    case PICOSAT_UNKNOWN:
+        /* no more solutions -- stop iteration */
+        break;
+
+    default:
+        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+    }
+    return result;
+}
+
+static void soliter_dealloc(soliterobject *it)
+{
+    PyTypeObject *tp = Py_TYPE(it);
+
+    PyObject_GC_UnTrack(it);
+    if (it->mem)
+        PyMem_Free(it->mem);
+    PyMem_Free(it->stack);
+    PyMem_Free(it->flipped);
+    PyMem_Free(it->cnf.lits);
+    picosat_reset(it->picosat);
+    PyObject_GC_Del(it);
+    RELEASE_TYPE(tp);
+}
+
+static int soliter_traverse(soliterobject *it, visitproc visit, void *arg)
+{
+#ifdef HEAP_TYPES
+    Py_VISIT(Py_TYPE(it));
+#endif
+    return 0;
+}
+
+#ifdef HEAP_TYPES
+static PyType_Slot soliter_slots[] = {
+    {Py_tp_dealloc, soliter_dealloc},
+    {Py_tp_traverse, soliter_traverse},
+    {Py_tp_iter, PyObject_SelfIter},
+    {Py_tp_iternext, soliter_next},
+    {0, NULL}
+};
+
+static PyType_Spec soliter_spec = {
+    "pycosat.soliterator", sizeof(soliterobject), 0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC |
+    Py_TPFLAGS_DISALLOW_INSTANTIATION, soliter_slots
+};
+#else
+static PyTypeObject SolIter_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.soliterator",                    /* tp_name */
+    sizeof(soliterobject),                    /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) soliter_dealloc,             /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
+    0,                                        /* tp_doc */
+    (traverseproc) soliter_traverse,          /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    PyObject_SelfIter,                        /* tp_iter */
+    (iternextfunc) soliter_next,              /* tp_iternext */
+    0,                                        /* tp_methods */
+};
+#endif
+
+/************************** Solution sampling **************************/
+
+/* Both sample and approx_count partition the solutions with random XOR
+   constraints into cells, and enumerate the solutions of one cell.  The
+   XORs are added in a new context, which is discarded with picosat_pop
+   afterwards, such that a single picosat instance is used for all cells. */
+
+/* A cell of sample is accepted if it contains at most this many
+   solutions */
+#define SAMPLE_CELL  16
+
+typedef struct {
+    PicoSAT *picosat;
+    int nvars;                  /* solutions consist of variables 1 to nvars */
+    int *support, nsupport;     /* variables of the XORs and cells */
+    unsigned long long rng;     /* state of the random number generator */
+    int *aux, naux, szaux;      /* auxiliary variables of the XOR chains */
+    int *xvars;                 /* literals of the current XOR */
+    signed char *rows, *work;   /* matrix of the XOR constraints */
+    int szrows;
+    signed char *cell;          /* solutions of the current cell, or NULL */
+} sampler;
+
+static unsigned sample_rand(sampler *sp)
+{
+    /* xorshift64* */
+    sp->rng ^= sp->rng >> 12;
+    sp->rng ^= sp->rng << 25;
+    sp->rng ^= sp->rng >> 27;
+    return (unsigned) ((sp->rng * 2685821657736338717ull) >> 32);
+}
+
+/* Return the i-th auxiliary variable, which is allocated on first use.
+   As all clauses containing auxiliary variables are discarded by
+   picosat_pop, the variables are reused in the following rounds. */
+static int sample_aux(sampler *sp, int i)
+{
+    int *aux;
+
+    if (i == sp->szaux) {
+        aux = PyMem_Realloc(sp->aux, 2 * (sp->szaux + 1) * sizeof(int));
+        if (aux == NULL) {
+            PyErr_NoMemory();
+            return 0;
+        }
+        sp->aux = aux;
+        sp->szaux = 2 * (sp->szaux + 1);
+    }
+    if (i == sp->naux)
+        sp->aux[sp->naux++] = picosat_inc_max_var(sp->picosat);
+    return sp->aux[i];
+}
+
+/* Add the clauses of the XOR of the k literals in 'lits' being true,
+   which for k <= 4 are simply the 2^(k-1) assignments of odd parity */
+static void add_short_xor(PicoSAT *picosat, const int *lits, int k)
+{
+    unsigned a, j, parity;
+
+    for (a = 0; a < (1u << k); a++) {
+        for (parity = 0, j = 0; j < (unsigned) k; j++)
+            parity ^= (a >> j) & 1;
+        if (parity)
+            continue;
+        /* block the even assignment a */
+        for (j = 0; j < (unsigned) k; j++)
+            picosat_add(picosat, (a >> j) & 1 ? -lits[j] : lits[j]);
+        picosat_add(picosat, 0);
+    }
+}
+
+/* Add the XOR of the literals x[0] to x[k-1] being true.  Long XORs are
+   split into a chain of short ones, where each link x1 ^ x2 ^ x3 is
+   replaced by a new auxiliary variable t. */
+static int add_xor(sampler *sp, int *x, int k, int *used)
+{
+    int t, lits[4];
+
+    while (k > 4) {
+        t = sample_aux(sp, (*used)++);
+        if (t == 0)
+            return -1;
+        /* x1 ^ x2 ^ x3 ^ -t, that is t == x1 ^ x2 ^ x3 */
+        lits[0] = x[k - 1];
+        lits[1] = x[k - 2];
+        lits[2] = x[k - 3];
+        lits[3] = -t;
+        add_short_xor(sp->picosat, lits, 4);
+        x[k - 3] = t;
+        k -= 2;
+    }
+    add_short_xor(sp->picosat, x, k);
+    return 0;
+}
+
+/* Draw m random XOR constraints over the support, each of which contains
+   every variable with probability 1/2.  The rows of the matrix start with
+   the parity. */
+static int random_rows(sampler *sp, int m)
+{
+    signed char *rows, *work;
+    int n = sp->nsupport + 1, i;
+
+    if (m > sp->szrows) {
+        rows = PyMem_Realloc(sp->rows, (size_t) m * n);
+        if (rows == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        sp->rows = rows;
+        work = PyMem_Realloc(sp->work, (size_t) m * n);
+        if (work == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        sp->work = work;
+        sp->szrows = m;
+    }
+    for (i = 0; i < m * n; i++)
+        sp->rows[i] = sample_rand(sp) & 1;
+    return 0;
+}
+
+/* Add the first m XOR constraints of sp->rows.  CDCL is bad at solving
+   dense systems of XORs, so the system is brought into reduced row
+   echelon form first.  Then every pivot variable occurs in only one XOR
+   and is propagated as soon as the other variables are assigned. */
+static int add_xors(sampler *sp, int m)
+{
+    signed char *rows = sp->work, *a, *b, c;
+    int n = sp->nsupport + 1;   /* row length, the parity is at index 0 */
+    int rank, row, col, i, k, used;
+
+    if (m == 0)
+        return 0;
+    memcpy(rows, sp->rows, (size_t) m * n);
+
+    for (rank = 0, col = 1; col < n && rank < m; col++) {
+        for (row = rank; row < m && !rows[row * n + col]; row++)
+            ;
+        if (row == m)
+            continue;
+        a = rows + row * n;
+        b = rows + rank * n;
+        for (i = 0; i < n; i++) {
+            c = a[i];
+            a[i] = b[i];
+            b[i] = c;
+        }
+        for (row = 0; row < m; row++) {
+            a = rows + row * n;
+            if (row != rank && a[col])
+                for (i = 0; i < n; i++)
+                    a[i] ^= b[i];
+        }
+        rank++;
+    }
+    for (row = rank; row < m; row++)
+        if (rows[row * n]) {
+            /* inconsistent system 0 = 1, so the cell is empty */
+            picosat_add(sp->picosat, 0);
+            return 0;
+        }
+
+    for (used = 0, row = 0; row < rank; row++) {
+        a = rows + row * n;
+        for (k = 0, col = 1; col < n; col++)
+            if (a[col])
+                sp->xvars[k++] = sp->support[col - 1];
+        if (!a[0])
+            sp->xvars[0] = -sp->xvars[0];
+        if (add_xor(sp, sp->xvars, k, &used) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Return the number of solutions (distinct on the support) of the cell
+   of the first m XOR constraints, where at most 'limit' solutions are
+   enumerated (into sp->cell, unless it is NULL).  Returns -1 if the
+   propagation limit was reached, or on errors with an exception set. */
+static int count_cell(sampler *sp, int m, int limit)
+{
+    PicoSAT *picosat = sp->picosat;
+    signed char *sol;
+    int count, res = PICOSAT_UNSATISFIABLE, i;
+
+    picosat_push(picosat);
+    if (add_xors(sp, m) < 0) {
+        picosat_pop(picosat);
+        return -1;
+    }
+    for (count = 0; count < limit; count++) {
+        Py_BEGIN_ALLOW_THREADS      /* release GIL */
+        res = picosat_sat(picosat, -1);
+        Py_END_ALLOW_THREADS
+
+        if (res != PICOSAT_SATISFIABLE)
+            break;
+
+        if (sp->cell) {
+            sol = sp->cell + count * sp->nvars;
+            for (i = 1; i <= sp->nvars; i++)
+                sol[i - 1] = picosat_deref(picosat, i) > 0 ? 1 : -1;
+        }
+        /* block the solution on the support */
+        for (i = 0; i < sp->nsupport; i++)
+            sp->xvars[i] = picosat_deref(picosat, sp->support[i]) > 0 ?
+                           -sp->support[i] : sp->support[i];
+        for (i = 0; i < sp->nsupport; i++)
+            picosat_add(picosat, sp->xvars[i]);
+        picosat_add(picosat, 0);
+    }
+    picosat_pop(picosat);
+    return res == PICOSAT_UNKNOWN ? -1 : count;
+}
+
+/* Create the picosat instance of the sampler.  The support consists of
+   the variables in 'project' (a list or buffer of integers), or of all
+   variables if it is NULL or None.  Without a 'seed' (NULL or None) the
+   seed is taken from the clock. */
+static int sampler_setup(sampler *sp, PyObject *clauses, PyObject *kwds,
+                         PyObject *project, PyObject *seed)
+{
+    PyObject *args;
+    unsigned long long s;
+    Py_ssize_t n, i;
+
+    memset(sp, 0, sizeof(sampler));
+
+    if (seed == NULL || seed == Py_None) {
+        s = (unsigned long long) time(NULL) ^
+            ((unsigned long long) clock() << 32);
+    }
+    else {
+        s = PyLong_AsUnsignedLongLongMask(seed);
+        if (s == (unsigned long long) -1 && PyErr_Occurred())
+            return -1;
+    }
+    sp->rng = s ^ 0x9e3779b97f4a7c15ull;
+    if (sp->rng == 0)
+        sp->rng = 1;
+
+    args = PyTuple_Pack(1, clauses);
+    if (args == NULL)
+        return -1;
+    sp->picosat = setup_picosat(args, kwds, NULL, NULL);
+    Py_DECREF(args);
+    if (sp->picosat == NULL)
+        return -1;
+    sp->nvars = picosat_variables(sp->picosat);
+
+    if (project && project != Py_None) {
+        n = get_lits(project, &sp->support);
+        if (n < 0)
+            return -1;
+        for (i = 0; i < n; i++)
+            if (sp->support[i] < 1 || sp->support[i] > sp->nvars) {
+                PyErr_Format(PyExc_ValueError, "invalid variable %d in "
+                             "project", sp->support[i]);
+                return -1;
+            }
+        sp->nsupport = (int) n;
+    }
+    else {
+        sp->support = PyMem_Malloc((sp->nvars + 1) * sizeof(int));
+        if (sp->support == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (i = 0; i < sp->nvars; i++)
+            sp->support[i] = (int) i + 1;
+        sp->nsupport = sp->nvars;
+    }
+
+    sp->xvars = PyMem_Malloc((sp->nsupport + 1) * sizeof(int));
+    if (sp->xvars == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void sampler_free(sampler *sp)
+{
+    if (sp->picosat)
+        picosat_reset(sp->picosat);
+    PyMem_Free(sp->support);
+    PyMem_Free(sp->aux);
+    PyMem_Free(sp->xvars);
+    PyMem_Free(sp->rows);
+    PyMem_Free(sp->work);
+    PyMem_Free(sp->cell);
+}
+
+static PyObject* sample_solution(sampler *sp, int index)
+{
+    PyObject *list;
+    signed char *sol = sp->cell + index * sp->nvars;
+    int i;
+
+    list = PyList_New((Py_ssize_t) sp->nvars);
+    if (list == NULL)
+        return NULL;
+    for (i = 0; i < sp->nvars; i++)
+        if (PyList_SetItem(list, (Py_ssize_t) i,
+                           PyInt_FromLong((long) (sol[i] * (i + 1)))) < 0) {
+            Py_DECREF(list);
+            return NULL;
+        }
+    return list;
+}
+
+/* Draw n near-uniform samples from the solutions of the clauses.
+
+   Each round adds m random XOR constraints, which partition the solutions
+   into 2^m cells of about equal size, and enumerates one cell.  If the
+   cell contains c <= SAMPLE_CELL solutions, one of them is returned with
+   probability c / SAMPLE_CELL, such that every solution is drawn with the
+   same probability 2^-m / SAMPLE_CELL.  Otherwise m is increased.  If
+   there are only few solutions in total, they are sampled directly. */
+static PyObject* sample(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *clauses, *seed = NULL, *own, *rest, *list = NULL, *sol;
+    Py_ssize_t n, drawn = 0;
+    sampler sp;
+    int m = 0, count, r, total;
+    static char* kwlist[] = {"clauses", "n", "seed", NULL};
+
+    memset(&sp, 0, sizeof(sampler));
+
+    if (split_keywords(kwds, kwlist, &own, &rest) < 0)
+        return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, own, "On|O:sample", kwlist,
+                                     &clauses, &n, &seed))
+        goto error;
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, "non-negative n expected");
+        goto error;
+    }
+    if (sampler_setup(&sp, clauses, rest, NULL, seed) < 0)
+        goto error;
+    sp.cell = PyMem_Malloc((SAMPLE_CELL + 1) * (sp.nvars + 1));
+    if (sp.cell == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    total = count_cell(&sp, 0, SAMPLE_CELL + 1);
+    if (total == 0) {
+        list = PyUnicode_FromString("UNSAT");
+        goto done;
+    }
+    if (total < 0) {
+        if (!PyErr_Occurred())
+            list = PyUnicode_FromString("UNKNOWN");
+        goto done;
+    }
+
+    list = PyList_New(0);
+    if (list == NULL)
+        goto error;
+
+    while (drawn < n) {
+        if (total <= SAMPLE_CELL) {
+            /* all solutions are known, so sample them directly */
+            r = (int) (sample_rand(&sp) % (unsigned) total);
+        }
+        else {
+            if (random_rows(&sp, m) < 0)
+                goto error;
+            count = count_cell(&sp, m, SAMPLE_CELL + 1);
+            if (count < 0) {
+                if (PyErr_Occurred())
+                    goto error;
+                break;
+            }
+            if (count > SAMPLE_CELL) {
+                m++;
+                continue;
+            }
+            r = (int) (sample_rand(&sp) % SAMPLE_CELL);
+            /* cells which are too small make most rounds fail */
+            if (count < SAMPLE_CELL / 4 && m > 0)
+                m--;
+            if (r >= count)
+                continue;
+        }
+        sol = sample_solution(&sp, r);
+        if (sol == NULL || PyList_Append(list, sol) < 0) {
+            Py_XDECREF(sol);
+            goto error;
+        }
+        Py_DECREF(sol);
+        drawn++;
+    }
+    goto done;
+
+ error:
+    Py_CLEAR(list);
+ done:
+    sampler_free(&sp);
+    Py_XDECREF(own);
+    Py_XDECREF(rest);
+    return list;
+}
+
+typedef struct {
+    int count, m;               /* estimate count * 2^m */
+} estimate;
+
+static int cmp_estimates(const void *p, const void *q)
+{
+    const estimate *a = p, *b = q;
+    double x = ldexp((double) a->count, a->m);
+    double y = ldexp((double) b->count, b->m);
+
+    return (x > y) - (x < y);
+}
+
+/* Find the smallest number m of the XOR constraints in sp->rows, such
+   that the cell has less than 'thresh' solutions, starting at 'start'.
+   Since the cells of m + 1 constraints are contained in those of m
+   constraints, the search leaps from the start in steps of 1, 2, 4, ...
+   and bisects the interval found.  Returns -1 if the propagation limit
+   was reached or on errors. */
+static int leapfrog(sampler *sp, int start, int thresh, estimate *e)
+{
+    int lo = 0, hi = -1, m, step, count;
+
+    /* the count of m = 0 is known to be at least thresh */
+    m = start < 1 ? 1 : (start > sp->nsupport ? sp->nsupport : start);
+    count = count_cell(sp, m, thresh);
+    if (count < 0)
+        return -1;
+
+    if (count >= thresh) {
+        lo = m;
+        for (step = 1; lo < sp->nsupport; step *= 2) {
+            m = lo + step > sp->nsupport ? sp->nsupport : lo + step;
+            count = count_cell(sp, m, thresh);
+            if (count < 0)
+                return -1;
+            if (count < thresh) {
+                hi = m;
+                e->count = count;
+                break;
+            }
+            lo = m;
+        }
+        if (hi < 0) {
+            /* even all XORs do not reduce the cell any further */
+            e->count = count;
+            e->m = lo;
+            return 0;
+        }
+    }
+    else {
+        hi = m;
+        e->count = count;
+        for (step = 1; hi - step > 0; step *= 2) {
+            m = hi - step;
+            count = count_cell(sp, m, thresh);
+            if (count < 0)
+                return -1;
+            if (count >= thresh) {
+                lo = m;
+                break;
+            }
+            hi = m;
+            e->count = count;
+        }
+    }
+
+    while (hi - lo > 1) {
+        m = (lo + hi) / 2;
+        count = count_cell(sp, m, thresh);
+        if (count < 0)
+            return -1;
+        if (count >= thresh)
+            lo = m;
+        else {
+            hi = m;
+            e->count = count;
+        }
+    }
+    e->m = hi;
+    return 0;
+}
+
+/* Approximate the number of solutions (projected onto the variables in
+   'project') within a factor of 1 + epsilon with probability 1 - delta,
+   following ApproxMC: the median of the estimates count * 2^m of t
+   independent rounds is returned, where m is the number of XORs for
+   which a cell has less than thresh solutions. */
+static PyObject* approx_count(PyObject *self, PyObject *args,
+                              PyObject *kwds)
+{
+    PyObject *clauses, *project = NULL, *seed = NULL, *own, *rest;
+    PyObject *result = NULL, *count, *shift;
+    double epsilon = 0.8, delta = 0.2;
+    estimate *estimates = NULL;
+    sampler sp;
+    int thresh, t, i, total, m;
+    static char* kwlist[] = {"clauses", "epsilon", "delta", "project",
+                             "seed", NULL};
+
+    memset(&sp, 0, sizeof(sampler));
+
+    if (split_keywords(kwds, kwlist, &own, &rest) < 0)
+        return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, own, "O|ddOO:approx_count",
+                                     kwlist, &clauses, &epsilon, &delta,
+                                     &project, &seed))
+        goto done;
+    if (!(epsilon > 0.0) || !(delta > 0.0 && delta < 1.0)) {
+        PyErr_SetString(PyExc_ValueError, "epsilon > 0 and 0 < delta < 1 "
+                        "expected");
+        goto done;
+    }
+    if (sampler_setup(&sp, clauses, rest, project, seed) < 0)
+        goto done;
+
+    thresh = (int) ceil(1.0 + 9.84 * (1.0 + epsilon / (1.0 + epsilon)) *
+                        (1.0 + 1.0 / epsilon) * (1.0 + 1.0 / epsilon));
+    t = (int) ceil(17.0 * log(3.0 / delta) / log(2.0));
+
+    total = count_cell(&sp, 0, thresh);
+    if (total < 0)
+        goto unknown;
+    if (total < thresh) {
+        /* few solutions are counted exactly */
+        result = PyInt_FromLong((long) total);
+        goto done;
+    }
+
+    estimates = PyMem_Malloc(t * sizeof(estimate));
+    if (estimates == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (m = 1, i = 0; i < t; i++) {
+        if (random_rows(&sp, sp.nsupport) < 0)
+            goto done;
+        if (leapfrog(&sp, m, thresh, estimates + i) < 0)
+            goto unknown;
+        m = estimates[i].m;
+    }
+    qsort(estimates, t, sizeof(estimate), cmp_estimates);
+
+    count = PyInt_FromLong((long) estimates[t / 2].count);
+    shift = PyInt_FromLong((long) estimates[t / 2].m);
+    if (count && shift)
+        result = PyNumber_Lshift(count, shift);
+    Py_XDECREF(count);
+    Py_XDECREF(shift);
+    goto done;
+
+ unknown:
+    if (!PyErr_Occurred())
+        result = PyUnicode_FromString("UNKNOWN");
+ done:
+    PyMem_Free(estimates);
+    sampler_free(&sp);
+    Py_XDECREF(own);
+    Py_XDECREF(rest);
+    return result;
+}
+
+/**************************** Symbol table ******************************/
+
+/* A VarMap assigns the variables 1, 2, ... to hashable names (typically
+   strings) in the order they are first seen.  The names are kept in an
+   array indexed by variable, and an open addressing hash table of
+   variables (zero for empty slots) maps names back to variables.  A
+   string name starting with the negation marker (default "~") denotes
+   the negative literal of the remaining name. */
+typedef struct {
+    PyObject_HEAD
+    PyObject **names;           /* names[v] for v = 1 .. count */
+    Py_hash_t *hashes;          /* the hash of names[v] */
+    int count, size;            /* number of variables, and allocated */
+    int *table;                 /* hash table of variables */
+    size_t mask;                /* size of table minus one */
+    PyObject *negation;         /* negation marker (string or NULL) */
+} varmapobject;
+
+static void varmap_dealloc(varmapobject *vm);
+
+#define VarMap_Check(op)  \
+    (Py_TYPE(op)->tp_dealloc == (destructor) varmap_dealloc)
+
+/* The names may refer back to the VarMap, so it takes part in the garbage
+   collection.  Clearing forgets all names (the table is emptied first). */
+static int varmap_clear(varmapobject *vm)
+{
+    int v, count = vm->count;
+
+    vm->count = 0;
+    if (vm->table)
+        memset(vm->table, 0, (vm->mask + 1) * sizeof(int));
+    for (v = 1; v <= count; v++)
+        Py_DECREF(vm->names[v]);
+    return 0;
+}
+
+static int varmap_traverse(varmapobject *vm, visitproc visit, void *arg)
+{
+    int v;
+
+#ifdef HEAP_TYPES
+    Py_VISIT(Py_TYPE(vm));
+#endif
+    for (v = 1; v <= vm->count; v++)
+        Py_VISIT(vm->names[v]);
+    return 0;
+}
+
+static void varmap_dealloc(varmapobject *vm)
+{
+    PyTypeObject *tp = Py_TYPE(vm);
+
+    PyObject_GC_UnTrack(vm);
+    varmap_clear(vm);
+    if (vm->names)
+        PyMem_Free(vm->names);
+    if (vm->hashes)
+        PyMem_Free(vm->hashes);
+    if (vm->table)
+        PyMem_Free(vm->table);
+    Py_XDECREF(vm->negation);
+    tp->tp_free((PyObject *) vm);
+    RELEASE_TYPE(tp);
+}
+
+/* Return the variable of 'name' (with hash 'h'), or zero if 'name' is not
+   in the table.  '*slot' is set to the slot where the search ended.  The
+   comparison may run Python code which adds names (or grows the table), in
+   which case the search is started again. */
+static int varmap_find(varmapobject *vm, PyObject *name, Py_hash_t h,
+                       size_t *slot)
+{
+    PyObject *other;
+    size_t i, mask;
+    int v, eq, count;
+
+ again:
+    mask = vm->mask;
+    count = vm->count;
+    i = (size_t) h & mask;
+    while ((v = vm->table[i])) {
+        if (vm->hashes[v] == h) {
+            other = vm->names[v];
+            if (other == name)
+                break;
+            Py_INCREF(other);
+            eq = PyObject_RichCompareBool(other, name, Py_EQ);
+            Py_DECREF(other);
+            if (eq < 0)
+                return -1;
+            if (vm->mask != mask || vm->count != count)
+                goto again;
+            if (eq)
+                break;
+        }
+        i = (i + 1) & mask;
+    }
+    *slot = i;
+    return v;
+}
+
+/* Double the size of the hash table */
+static int varmap_grow(varmapobject *vm)
+{
+    size_t mask = 2 * vm->mask + 1, i;
+    int *table, v;
+
+    table = PyMem_Malloc((mask + 1) * sizeof(int));
+    if (table == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(table, 0, (mask + 1) * sizeof(int));
+    for (v = 1; v <= vm->count; v++) {
+        for (i = (size_t) vm->hashes[v] & mask; table[i];
+             i = (i + 1) & mask)
+            ;
+        table[i] = v;
+    }
+    PyMem_Free(vm->table);
+    vm->table = table;
+    vm->mask = mask;
+    return 0;
+}
+
+/* Return the variable of 'name', which is added if 'add' is non-zero and
+   'name' is new.  Returns zero for unknown names (if 'add' is zero), and
+   -1 with an exception set on errors. */
+static int varmap_var(varmapobject *vm, PyObject *name, int add)
+{
+    Py_hash_t h;
+    size_t slot;
+    void *p;
+    int v, size;
+
+    h = PyObject_Hash(name);
+    if (h == -1)
+        return -1;
+    v = varmap_find(vm, name, h, &slot);
+    if (v || !add)
+        return v;
+
+    if (vm->count == INT_MAX - 1) {
+        PyErr_SetString(PyExc_OverflowError, "too many variables");
+        return -1;
+    }
+    if (vm->count + 1 >= vm->size) {
+        size = 2 * vm->size + 16;
+        p = PyMem_Realloc(vm->names, size * sizeof(PyObject *));
+        if (p == NULL)
+            goto nomem;
+        vm->names = p;
+        p = PyMem_Realloc(vm->hashes, size * sizeof(Py_hash_t));
+        if (p == NULL)
+            goto nomem;
+        vm->hashes = p;
+        vm->size = size;
+    }
+    v = ++vm->count;
+    Py_INCREF(name);
+    vm->names[v] = name;
+    vm->hashes[v] = h;
+    vm->table[slot] = v;
+    /* keep the load factor below 1/2 */
+    if ((size_t) vm->count > vm->mask / 2 && varmap_grow(vm) < 0)
+        return -1;
+    return v;
+
+ nomem:
+    PyErr_NoMemory();
+    return -1;
+}
+
+/* Return the literal of 'obj', i.e. the variable of the name, negated if
+   'obj' starts with the negation marker.  See varmap_var for 'add'. */
+static int varmap_lit(varmapobject *vm, PyObject *obj, int add)
+{
+    PyObject *name;
+    Py_ssize_t n, k;
+    int v;
+
+    if (vm->negation == NULL || Py_TYPE(obj) != Py_TYPE(vm->negation))
+        return varmap_var(vm, obj, add);
+
+#ifdef IS_PY3K
+    n = PyUnicode_GET_LENGTH(obj);
+    k = PyUnicode_GET_LENGTH(vm->negation);
+    if (k == 0 || n <= k ||
+            PyUnicode_Tailmatch(obj, vm->negation, 0, k, -1) != 1)
+        return varmap_var(vm, obj, add);
+    name = PyUnicode_Substring(obj, k, n);
+#else
+    n = PyString_GET_SIZE(obj);
+    k = PyString_GET_SIZE(vm->negation);
+    if (k == 0 || n <= k || memcmp(PyString_AS_STRING(obj),
+                                   PyString_AS_STRING(vm->negation), k))
+        return varmap_var(vm, obj, add);
+    name = PyString_FromStringAndSize(PyString_AS_STRING(obj) + k, n - k);
+#endif
+    if (name == NULL)
+        return -1;
+    v = varmap_var(vm, name, add);
+    Py_DECREF(name);
+    return v > 0 ? -v : v;
+}
+
+/* Like get_lits, but 'obj' is an iterable of names, which are interned */
+static Py_ssize_t varmap_lits(varmapobject *vm, PyObject *obj, int **lits)
+{
+    PyObject *seq, *item;
+    Py_ssize_t n, i;
+    int lit;
+
+    seq = PySequence_Fast(obj, "iterable of names expected");
+    if (seq == NULL)
+        return -1;
+    n = PySequence_Fast_GET_SIZE(seq);
+    *lits = PyMem_Malloc((n + 1) * sizeof(int));
+    if (*lits == NULL) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        item = PySequence_Fast_GET_ITEM(seq, i);
+        lit = varmap_lit(vm, item, 1);
+        if (lit == -1 && PyErr_Occurred()) {
+            Py_DECREF(seq);
+            PyMem_Free(*lits);
+            *lits = NULL;
+            return -1;
+        }
+        (*lits)[i] = lit;
+    }
+    (*lits)[n] = 0;
+    Py_DECREF(seq);
+    return n;
+}
+
+/* Return the set of names of the variables 1 to 'max_idx' which are true
+   in the current solution of 'picosat' */
+static PyObject* varmap_model(varmapobject *vm, PicoSAT *picosat,
+                              int max_idx)
+{
+    PyObject *set;
+    int v;
+
+    set = PySet_New(NULL);
+    if (set == NULL)
+        return NULL;
+    if (max_idx > vm->count)
+        max_idx = vm->count;
+    for (v = 1; v <= max_idx; v++)
+        if (picosat_deref(picosat, v) > 0 &&
+                PySet_Add(set, vm->names[v]) < 0) {
+            Py_DECREF(set);
+            return NULL;
+        }
+    return set;
+}
+
+static PyObject* varmap_intern(varmapobject *vm, PyObject *name)
+{
+    int v = varmap_var(vm, name, 1);
+
+    return v < 0 ? NULL : PyInt_FromLong((long) v);
+}
+
+/* Intern all names of an iterable and return the list of variables */
+static PyObject* varmap_intern_all(varmapobject *vm, PyObject *names)
+{
+    PyObject *iter, *item, *list, *var;
+    int v;
+
+    list = PyList_New(0);
+    iter = PyObject_GetIter(names);
+    if (list == NULL || iter == NULL)
+        goto error;
+
+    while ((item = PyIter_Next(iter)) != NULL) {
+        v = varmap_var(vm, item, 1);
+        Py_DECREF(item);
+        if (v < 0)
+            goto error;
+        var = PyInt_FromLong((long) v);
+        if (var == NULL || PyList_Append(list, var) < 0) {
+            Py_XDECREF(var);
+            goto error;
+        }
+        Py_DECREF(var);
+    }
+    if (PyErr_Occurred())
+        goto error;
+    Py_DECREF(iter);
+    return list;
+
+ error:
+    Py_XDECREF(iter);
+    Py_XDECREF(list);
+    return NULL;
+}
+
+/* Return the literal of a (possibly negated) name, or raise KeyError */
+static PyObject* varmap_lookup(varmapobject *vm, PyObject *obj)
+{
+    int lit = varmap_lit(vm, obj, 0);
+
+    if (lit == -1 && PyErr_Occurred())
+        return NULL;
+    if (lit == 0) {
+        PyErr_SetObject(PyExc_KeyError, obj);
+        return NULL;
+    }
+    return PyInt_FromLong((long) lit);
+}
+
+/* Return the name of the variable of a literal */
+static PyObject* varmap_name(varmapobject *vm, PyObject *lit)
+{
+    long v;
+
+    if (!IS_INT(lit)) {
+        PyErr_SetString(PyExc_TypeError, "interger expected");
+        return NULL;
+    }
+    v = PyLong_AsLong(lit);
+    if (v == -1 && PyErr_Occurred())
+        return NULL;
+    if (v < 0)
+        v = -v;
+    if (v == 0 || v > vm->count) {
+        PyErr_Format(PyExc_IndexError, "unknown variable %ld", v);
+        return NULL;
+    }
+    Py_INCREF(vm->names[v]);
+    return vm->names[v];
+}
+
+/* Translate clauses of names into clauses of integers */
+static PyObject* varmap_clauses(varmapobject *vm, PyObject *clauses)
+{
+    PyObject *iter, *item, *list, *clause, *lit;
+    Py_ssize_t n, i;
+    int *lits;
+
+    list = PyList_New(0);
+    iter = PyObject_GetIter(clauses);
+    if (list == NULL || iter == NULL)
+        goto error;
+
+    while ((item = PyIter_Next(iter)) != NULL) {
+        n = varmap_lits(vm, item, &lits);
+        Py_DECREF(item);
+        if (n < 0)
+            goto error;
+        clause = PyList_New(n);
+        for (i = 0; clause && i < n; i++) {
+            lit = PyInt_FromLong((long) lits[i]);
+            if (lit == NULL)
+                Py_CLEAR(clause);
+            else
+                PyList_SET_ITEM(clause, i, lit);
+        }
+        PyMem_Free(lits);
+        if (clause == NULL || PyList_Append(list, clause) < 0) {
+            Py_XDECREF(clause);
+            goto error;
+        }
+        Py_DECREF(clause);
+    }
+    if (PyErr_Occurred())
+        goto error;
+    Py_DECREF(iter);
+    return list;
+
+ error:
+    Py_XDECREF(iter);
+    Py_XDECREF(list);
+    return NULL;
+}
+
+/* Translate a solution (a list or buffer of integers) into the set of
+   names of the true variables */
+static PyObject* varmap_solution(varmapobject *vm, PyObject *solution)
+{
+    PyObject *set;
+    Py_ssize_t n, i;
+    int *lits;
+
+    n = get_lits(solution, &lits);
+    if (n < 0)
+        return NULL;
+    set = PySet_New(NULL);
+    for (i = 0; set && i < n; i++) {
+        if (lits[i] < 0 || lits[i] > vm->count)
+            continue;
+        if (PySet_Add(set, vm->names[lits[i]]) < 0)
+            Py_CLEAR(set);
+    }
+    PyMem_Free(lits);
+    return set;
+}
+
+static PyObject* varmap_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds)
+{
+    varmapobject *vm;
+    PyObject *names = NULL, *negation = NULL, *list;
+    static char* kwlist[] = {"names", "negation", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO:VarMap", kwlist,
+                                     &names, &negation))
+        return NULL;
+
+    /* the default marker is "~", and None disables negated names */
+    if (negation == NULL)
+#ifdef IS_PY3K
+        negation = PyUnicode_FromString("~");
+    else if (negation == Py_None || PyUnicode_Check(negation))
+#else
+        negation = PyString_FromString("~");
+    else if (negation == Py_None || PyString_Check(negation))
+#endif
+        Py_INCREF(negation);
+    else {
+        PyErr_SetString(PyExc_TypeError, "string expected");
+        return NULL;
+    }
+    if (negation == NULL)
+        return NULL;
+    if (negation == Py_None)
+        Py_CLEAR(negation);
+
+    vm = (varmapobject *) type->tp_alloc(type, 0);
+    if (vm == NULL) {
+        Py_XDECREF(negation);
+        return NULL;
+    }
+    vm->names = NULL;
+    vm->hashes = NULL;
+    vm->count = vm->size = 0;
+    vm->negation = negation;
+    vm->mask = 15;
+    vm->table = PyMem_Malloc((vm->mask + 1) * sizeof(int));
+    if (vm->table == NULL) {
+        Py_DECREF(vm);
+        return PyErr_NoMemory();
+    }
+    memset(vm->table, 0, (vm->mask + 1) * sizeof(int));
+
+    if (names && names != Py_None) {
+        list = varmap_intern_all(vm, names);
+        if (list == NULL) {
+            Py_DECREF(vm);
+            return NULL;
+        }
+        Py_DECREF(list);
+    }
+    return (PyObject *) vm;
+}
+
+static Py_ssize_t varmap_length(varmapobject *vm)
+{
+    return vm->count;
+}
+
+static int varmap_contains(varmapobject *vm, PyObject *name)
+{
+    int v = varmap_var(vm, name, 0);
+
+    return v < 0 ? -1 : v > 0;
+}
+
+static PyObject* varmap_names(varmapobject *vm)
+{
+    PyObject *list;
+    int v;
+
+    list = PyList_New(vm->count);
+    if (list == NULL)
+        return NULL;
+    for (v = 1; v <= vm->count; v++) {
+        Py_INCREF(vm->names[v]);
+        PyList_SET_ITEM(list, v - 1, vm->names[v]);
+    }
+    return list;
+}
+
+static PyMethodDef varmap_methods[] = {
+    {"intern",      (PyCFunction) varmap_intern,      METH_O},
+    {"intern_all",  (PyCFunction) varmap_intern_all,  METH_O},
+    {"name",        (PyCFunction) varmap_name,        METH_O},
+    {"names",       (PyCFunction) varmap_names,       METH_NOARGS},
+    {"clauses",     (PyCFunction) varmap_clauses,     METH_O},
+    {"solution",    (PyCFunction) varmap_solution,    METH_O},
+    {NULL,          NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot varmap_slots[] = {
+    {Py_tp_dealloc, varmap_dealloc},
+    {Py_tp_traverse, varmap_traverse},
+    {Py_tp_clear, varmap_clear},
+    {Py_tp_methods, varmap_methods},
+    {Py_tp_new, varmap_new},
+    {Py_sq_length, varmap_length},
+    {Py_sq_contains, varmap_contains},
+    {Py_mp_length, varmap_length},
+    {Py_mp_subscript, varmap_lookup},
+    {0, NULL}
+};
+
+static PyType_Spec varmap_spec = {
+    "pycosat.VarMap", sizeof(varmapobject), 0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, varmap_slots
+};
+#else
+static PySequenceMethods varmap_as_sequence = {
+    (lenfunc) varmap_length,                  /* sq_length */
+    0,                                        /* sq_concat */
+    0,                                        /* sq_repeat */
+    0,                                        /* sq_item */
+    0,                                        /* sq_slice */
+    0,                                        /* sq_ass_item */
+    0,                                        /* sq_ass_slice */
+    (objobjproc) varmap_contains,             /* sq_contains */
+};
+
+static PyMappingMethods varmap_as_mapping = {
+    (lenfunc) varmap_length,                  /* mp_length */
+    (binaryfunc) varmap_lookup,               /* mp_subscript */
+    0,                                        /* mp_ass_subscript */
+};
+
+static PyTypeObject VarMap_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.VarMap",                         /* tp_name */
+    sizeof(varmapobject),                     /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) varmap_dealloc,              /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &varmap_as_sequence,                      /* tp_as_sequence */
+    &varmap_as_mapping,                       /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
+    0,                                        /* tp_doc */
+    (traverseproc) varmap_traverse,           /* tp_traverse */
+    (inquiry) varmap_clear,                   /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    varmap_methods,                           /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    varmap_new,                               /* tp_new */
+};
+#endif
+
+/**************************** Solver object ****************************/
+
+typedef struct {
+    PyObject_HEAD
+    PicoSAT *picosat;
+    unsigned long long prop_limit;  /* default limit for each call */
+    int nvars;                  /* largest variable, without groups */
+    int group;                  /* group of added clauses (or zero) */
+    int busy;                   /* inside picosat_sat (GIL released) */
+    int *cnf;                   /* recorded clauses: group, lits..., 0 */
+    Py_ssize_t ncnf, szcnf;
+    varmapobject *varmap;       /* names of the variables (or NULL) */
+} solverobject;
+
+
+/* The solver must not be used while another thread is solving */
+static int solver_check_busy(solverobject *self)
+{
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "solver is busy");
+        return -1;
+    }
+    return 0;
+}
+
+static int solver_add_all(solverobject *self, PyObject *clauses);
+
+static PyObject* solver_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds)
+{
+    solverobject *self = NULL;
+    PyObject *clauses = NULL, *varmap = NULL, *setup_args, *item;
+    PyObject *own, *setup_kwds;
+    Py_ssize_t n, i;
+    static char* names[] = {"clauses", "varmap", NULL};
+
+    /* The clauses are optional (unlike in solve and itersolve), and are
+       added after the setup like all other clauses, such that they are
+       recorded as well.  The setup gets an empty list instead. */
+    if (split_keywords(kwds, names, &own, &setup_kwds) < 0)
+        return NULL;
+    kwds = setup_kwds;
+    n = PyTuple_GET_SIZE(args);
+    if (n > 0)
+        clauses = PyTuple_GET_ITEM(args, 0);
+    else if (own)
+        clauses = PyDict_GetItemString(own, "clauses");
+    if (own)
+        varmap = PyDict_GetItemString(own, "varmap");
+    if (clauses && !PyList_Check(clauses) && !PyObject_CheckBuffer(clauses)) {
+        PyErr_SetString(PyExc_TypeError, "list expected");
+        goto error;
+    }
+    if (varmap == Py_None)
+        varmap = NULL;
+    if (varmap && !VarMap_Check(varmap)) {
+        PyErr_SetString(PyExc_TypeError, "VarMap expected");
+        goto error;
+    }
+
+    setup_args = PyTuple_New(n ? n : 1);
+    if (setup_args == NULL)
+        goto error;
+    for (i = 0; i < (n ? n : 1); i++) {
+        item = i ? PyTuple_GET_ITEM(args, i) : PyList_New(0);
+        if (item == NULL) {
+            Py_DECREF(setup_args);
+            goto error;
+        }
+        if (i)
+            Py_INCREF(item);
+        PyTuple_SET_ITEM(setup_args, i, item);
+    }
+
+    self = (solverobject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        Py_DECREF(setup_args);
+        goto error;
+    }
+    self->busy = 0;
+    self->group = 0;
+    self->prop_limit = 0;
+    self->cnf = NULL;
+    self->ncnf = self->szcnf = 0;
+    Py_XINCREF(varmap);
+    self->varmap = (varmapobject *) varmap;
+    self->picosat = setup_picosat(setup_args, kwds, &self->prop_limit, NULL);
+    Py_DECREF(setup_args);
+    if (self->picosat == NULL)
+        goto error;
+    self->nvars = picosat_variables(self->picosat);
+
+    if (clauses && solver_add_all(self, clauses) < 0)
+        goto error;
+
+    Py_XDECREF(own);
+    Py_XDECREF(setup_kwds);
+    return (PyObject *) self;
+
+ error:
+    Py_XDECREF(self);
+    Py_XDECREF(own);
+    Py_XDECREF(setup_kwds);
+    return NULL;
+}
+
+static void solver_dealloc(solverobject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+
+    if (self->picosat)
+        picosat_reset(self->picosat);
+    if (self->cnf)
+        PyMem_Free(self->cnf);
+    Py_XDECREF(self->varmap);
+    tp->tp_free((PyObject *) self);
+    RELEASE_TYPE(tp);
+}
+
+/* Record a clause (with its group), such that copies of the solver can be
+   created for solving in parallel. */
+static int solver_record(solverobject *self, const int *lits, Py_ssize_t n)
+{
+    Py_ssize_t size;
+    int *cnf;
+
+    if (self->ncnf + n + 2 > self->szcnf) {
+        size = 2 * self->szcnf + n + 2;
+        cnf = PyMem_Realloc(self->cnf, size * sizeof(int));
+        if (cnf == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->cnf = cnf;
+        self->szcnf = size;
+    }
+    self->cnf[self->ncnf++] = self->group;
+    memcpy(self->cnf + self->ncnf, lits, n * sizeof(int));
+    self->ncnf += n;
+    self->cnf[self->ncnf++] = 0;
+    return 0;
+}
+
+/* Remove the recorded clauses of a deleted group */
+static void solver_unrecord(solverobject *self, int group)
+{
+    Py_ssize_t i, j, k;
+
+    for (i = j = 0; i < self->ncnf; i = k + 1) {
+        for (k = i + 1; self->cnf[k]; k++)
+            ;
+        if (self->cnf[i] == group)
+            continue;
+        memmove(self->cnf + j, self->cnf + i, (k + 1 - i) * sizeof(int));
+        j += k + 1 - i;
+    }
+    self->ncnf = j;
+}
+
+/* The internal variables of clause groups share their indices with the
+   ordinary variables.  Therefore new variables can only be used as long as
+   no group has been added. */
+static int solver_check_vars(solverobject *self, const int *lits,
+                             Py_ssize_t n)
+{
+    Py_ssize_t i;
+    int max_idx = self->nvars;
+
+    for (i = 0; i < n; i++)
+        if (abs(lits[i]) > max_idx)
+            max_idx = abs(lits[i]);
+
+    if (max_idx > self->nvars) {
+        if (picosat_variables(self->picosat) > self->nvars) {
+            PyErr_Format(PyExc_ValueError, "new variable %d after "
+                         "add_group (use the vars argument)", max_idx);
+            return -1;
+        }
+        self->nvars = max_idx;
+    }
+    return 0;
+}
+
+/* Add the clause of the 'n' literals 'lits', which are zero terminated */
+static int solver_add_lits(solverobject *self, const int *lits,
+                           Py_ssize_t n)
+{
+    if (solver_check_vars(self, lits, n) < 0 ||
+            solver_record(self, lits, n) < 0)
+        return -1;
+
+    picosat_add_lits(self->picosat, (int *) lits);
+    return 0;
+}
+
+/* Add the literals of 'clause' (a list or buffer of integers), such that
+   no partial clause is left behind on errors. */
+static int solver_add(solverobject *self, PyObject *clause)
+{
+    Py_ssize_t n;
+    int *lits, res;
+
+    n = get_lits(clause, &lits);
+    if (n < 0)
+        return -1;
+    res = solver_add_lits(self, lits, n);
+    PyMem_Free(lits);
+    return res;
+}
+
+/* Add the zero terminated clauses of a ClauseBuffer, CNF or buffer */
+static int solver_add_flat(solverobject *self, PyObject *clauses)
+{
+    const flatcnf *cnf;
+    flatcnf f;
+    const int *p, *q;
+    int res = 0;
+
+    cnf = get_flatcnf(clauses);
+    if (cnf == NULL) {
+        if (flat_clauses(clauses, &f) < 0)
+            return -1;
+        cnf = &f;
+    }
+    for (p = cnf->lits; res == 0 && p < cnf->lits + cnf->n; p = q + 1) {
+        for (q = p; *q; q++)
+            ;
+        res = solver_add_lits(self, p, q - p);
+    }
+    if (cnf == &f)
+        PyMem_Free(f.lits);
+    return res;
+}
+
+static PyObject* solver_add_clause(solverobject *self, PyObject *clause)
+{
+    if (solver_check_busy(self) < 0 || solver_add(self, clause) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Add all clauses of the iterable 'clauses' */
+static int solver_add_all(solverobject *self, PyObject *clauses)
+{
+    PyObject *iter, *item;
+
+    if (PyObject_CheckBuffer(clauses))
+        return solver_add_flat(self, clauses);
+
+    iter = PyObject_GetIter(clauses);
+    if (iter == NULL)
+        return -1;
+
+    while ((item = PyIter_Next(iter)) != NULL) {
+        if (solver_add(self, item) < 0) {
+            Py_DECREF(item);
+            Py_DECREF(iter);
+            return -1;
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(iter);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static PyObject* solver_add_clauses(solverobject *self, PyObject *clauses)
+{
+    if (solver_check_busy(self) < 0 || solver_add_all(self, clauses) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Return the symbol table of the solver, which is created on demand */
+static varmapobject* solver_get_varmap(solverobject *self)
+{
+    if (self->varmap == NULL)
+        self->varmap = (varmapobject *) PyObject_CallObject(
+                (PyObject *) type_state(Py_TYPE(self))->VarMap_Type, NULL);
+    return self->varmap;
+}
+
+static PyObject* solver_varmap(solverobject *self, void *closure)
+{
+    PyObject *vm = (PyObject *) solver_get_varmap(self);
+
+    Py_XINCREF(vm);
+    return vm;
+}
+
+/* Add the clauses of names in the iterable 'clauses' */
+static int solver_add_named(solverobject *self, PyObject *clauses)
+{
+    PyObject *iter, *item;
+    varmapobject *vm;
+    Py_ssize_t n;
+    int *lits, res;
+
+    vm = solver_get_varmap(self);
+    if (vm == NULL)
+        return -1;
+    iter = PyObject_GetIter(clauses);
+    if (iter == NULL)
+        return -1;
+
+    while ((item = PyIter_Next(iter)) != NULL) {
+        n = varmap_lits(vm, item, &lits);
+        Py_DECREF(item);
+        if (n < 0)
+            res = -1;
+        else {
+            res = solver_add_lits(self, lits, n);
+            PyMem_Free(lits);
+        }
+        if (res < 0) {
+            Py_DECREF(iter);
+            return -1;
+        }
+    }
+    Py_DECREF(iter);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static PyObject* solver_add_named_clauses(solverobject *self,
+                                          PyObject *clauses)
+{
+    if (solver_check_busy(self) < 0 || solver_add_named(self, clauses) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Like solve, but the assumptions are names and the solution is returned
+   as the set of names of the true variables */
+static PyObject* solver_solve_named(solverobject *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    PyObject *assumptions = NULL, *result = NULL;
+    unsigned long long prop_limit = self->prop_limit;
+    varmapobject *vm;
+    Py_ssize_t n, i;
+    int *lits, res;
+    static char* kwlist[] = {"assumptions", "prop_limit", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OK:solve_named", kwlist,
+                                     &assumptions, &prop_limit))
+        return NULL;
+
+    if (solver_check_busy(self) < 0 || (vm = solver_get_varmap(self)) == NULL)
+        return NULL;
+
+    if (assumptions && assumptions != Py_None) {
+        n = varmap_lits(vm, assumptions, &lits);
+        if (n < 0)
+            return NULL;
+        if (solver_check_vars(self, lits, n) < 0) {
+            PyMem_Free(lits);
+            return NULL;
+        }
+        for (i = 0; i < n; i++)
+            picosat_assume(self->picosat, lits[i]);
+        PyMem_Free(lits);
+    }
+
+    picosat_set_propagation_limit(self->picosat, prop_limit ?
+            picosat_propagations(self->picosat) + prop_limit : ~0ull);
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    res = picosat_sat(self->picosat, -1);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    switch (res) {
+    case PICOSAT_SATISFIABLE:
+        result = varmap_model(vm, self->picosat, self->nvars);
+        break;
+
+    case PICOSAT_UNSATISFIABLE:
+        result = PyUnicode_FromString("UNSAT");
+        break;
+
+    case PICOSAT_UNKNOWN:
+        result = PyUnicode_FromString("UNKNOWN");
+        break;
+
+    default:
+        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+    }
+    return result;
+}
+
+static PyObject* solver_solve(solverobject *self, PyObject *args,
+                              PyObject *kwds)
+{
+    PyObject *assumptions = NULL, *result;
+    unsigned long long prop_limit = self->prop_limit;
+    Py_ssize_t n, i;
+    int *lits;
+    static char* kwlist[] = {"assumptions", "prop_limit", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OK:solve", kwlist,
+                                     &assumptions, &prop_limit))
+        return NULL;
+
+    if (solver_check_busy(self) < 0)
+        return NULL;
+
+    if (assumptions && assumptions != Py_None) {
+        n = get_lits(assumptions, &lits);
+        if (n < 0)
+            return NULL;
+        if (solver_check_vars(self, lits, n) < 0) {
+            PyMem_Free(lits);
+            return NULL;
+        }
+        for (i = 0; i < n; i++)
+            picosat_assume(self->picosat, lits[i]);
+        PyMem_Free(lits);
+    }
+
+    /* the propagation limit of picosat is absolute, while the limit here
+       is relative to the start of this call (zero means no limit) */
+    picosat_set_propagation_limit(self->picosat, prop_limit ?
+            picosat_propagations(self->picosat) + prop_limit : ~0ull);
+
+    self->busy = 1;
+    result = run_solve(self->picosat, self->nvars);
+    self->busy = 0;
+    return result;
+}
+
+static PyObject* solver_propagate(solverobject *self, PyObject *args,
+                                  PyObject *kwds)
+{
+    PyObject *assumptions = NULL, *list, *lit;
+    static const int nolits[1] = {0};
+    const int *p;
+    Py_ssize_t n, i;
+    int *lits, res;
+    static char* kwlist[] = {"assumptions", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:propagate", kwlist,
+                                     &assumptions))
+        return NULL;
+
+    if (solver_check_busy(self) < 0)
+        return NULL;
+
+    if (assumptions && assumptions != Py_None) {
+        n = get_lits(assumptions, &lits);
+        if (n < 0)
+            return NULL;
+        if (solver_check_vars(self, lits, n) < 0) {
+            PyMem_Free(lits);
+            return NULL;
+        }
+        for (i = 0; i < n; i++)
+            picosat_assume(self->picosat, lits[i]);
+        PyMem_Free(lits);
+    }
+
+    res = picosat_propagate(self->picosat, nolits);
+
+    list = PyList_New(0);
+    if (list == NULL)
+        return NULL;
+    for (p = picosat_propagated(self->picosat); *p; p++) {
+        if (abs(*p) > self->nvars)
+            continue;
+        lit = PyInt_FromLong((long) *p);
+        if (lit == NULL || PyList_Append(list, lit) < 0) {
+            Py_XDECREF(lit);
+            Py_DECREF(list);
+            return NULL;
+        }
+        Py_DECREF(lit);
+    }
+    return Py_BuildValue("(ON)", res == PICOSAT_UNSATISFIABLE ?
+                         Py_False : Py_True, list);
+}
+
+/* A query of solve_assumptions_batch.  The workers run without the GIL,
+   and therefore use malloc for the model and failed assumptions. */
+typedef struct {
+    int *lits;                  /* zero terminated sorted assumptions */
+    Py_ssize_t index;           /* position in the list of queries */
+    int res;                    /* result of picosat */
+    signed char *model;         /* values of all variables (if SAT) */
+    int *failed;                /* zero terminated failed assumptions */
+} batchquery;
+
+typedef struct {
+    PicoSAT *picosat;
+    solverobject *solver;       /* not modified by the workers */
+    const char *skip;           /* disabled groups */
+    int copy;                   /* picosat is a copy of the solver */
+    batchquery *begin, *end;
+    unsigned long long prop_limit;
+    int models, failed;
+    int nomem;
+    PyThread_type_lock done;
+} batchworker;
+
+static int cmp_lits_by_var(const void *p, const void *q)
+{
+    int a = *(const int *) p, b = *(const int *) q;
+
+    if (abs(a) != abs(b))
+        return abs(a) < abs(b) ? -1 : 1;
+    return a < b ? -1 : (a > b);
+}
+
+/* lexicographic order, such that queries with common prefixes are next to
+   each other */
+static int cmp_queries(const void *p, const void *q)
+{
+    const int *a = ((const batchquery *) p)->lits;
+    const int *b = ((const batchquery *) q)->lits;
+
+    while (*a && *a == *b)
+        a++, b++;
+    if (*a == *b)
+        return 0;
+    if (!*a || !*b)
+        return *a ? 1 : -1;
+    return cmp_lits_by_var(a, b);
+}
+
+/* Add the recorded clauses of the solver (without disabled groups) */
+static void batch_copy_clauses(batchworker *w)
+{
+    const int *p = w->solver->cnf, *end = p + w->solver->ncnf;
+    int group;
+
+    while (p < end) {
+        group = *p++;
+        if (group && w->skip[group]) {
+            while (*p++)
+                ;
+            continue;
+        }
+        do
+            picosat_add(w->picosat, *p);
+        while (*p++);
+    }
+}
+
+static void batch_run(batchworker *w)
+{
+    PicoSAT *picosat = w->picosat;
+    int nvars = w->solver->nvars, i, n;
+    const int *failed;
+    batchquery *q;
+
+    if (w->copy)
+        batch_copy_clauses(w);
+
+    for (q = w->begin; q < w->end; q++) {
+        picosat_set_propagation_limit(picosat, w->prop_limit ?
+                picosat_propagations(picosat) + w->prop_limit : ~0ull);
+        q->res = picosat_sat_assuming(picosat, q->lits, -1);
+
+        if (q->res == PICOSAT_SATISFIABLE && w->models) {
+            q->model = malloc(nvars + 1);
+            if (q->model == NULL) {
+                w->nomem = 1;
+                break;
+            }
+            for (i = 1; i <= nvars; i++)
+                q->model[i] = picosat_deref(picosat, i) > 0 ? 1 : -1;
+        }
+        if (q->res == PICOSAT_UNSATISFIABLE && w->failed) {
+            failed = picosat_failed_assumptions(picosat);
+            for (n = 0; failed[n]; n++)
+                ;
+            q->failed = malloc((n + 1) * sizeof(int));
+            if (q->failed == NULL) {
+                w->nomem = 1;
+                break;
+            }
+            /* without the internal literals of groups */
+            for (n = i = 0; failed[i]; i++)
+                if (abs(failed[i]) <= nvars)
+                    q->failed[n++] = failed[i];
+            q->failed[n] = 0;
+        }
+    }
+}
+
+static void batch_thread(void *arg)
+{
+    batchworker *w = (batchworker *) arg;
+
+    batch_run(w);
+    PyThread_release_lock(w->done);
+}
+
+static PyObject* batch_result(batchquery *q, int nvars)
+{
+    PyObject *list;
+    int i, n;
+
+    switch (q->res) {
+    case PICOSAT_SATISFIABLE:
+        if (q->model == NULL)
+            return PyUnicode_FromString("SAT");
+        list = PyList_New((Py_ssize_t) nvars);
+        if (list == NULL)
+            return NULL;
+        for (i = 1; i <= nvars; i++)
+            PyList_SET_ITEM(list, i - 1, PyInt_FromLong(q->model[i] * i));
+        return list;
+
+    case PICOSAT_UNSATISFIABLE:
+        if (q->failed == NULL)
+            return PyUnicode_FromString("UNSAT");
+        for (n = 0; q->failed[n]; n++)
+            ;
+        list = PyList_New((Py_ssize_t) n);
+        if (list == NULL)
+            return NULL;
+        for (i = 0; i < n; i++)
+            PyList_SET_ITEM(list, i, PyInt_FromLong(q->failed[i]));
+        return list;
+
+    case PICOSAT_UNKNOWN:
+        return PyUnicode_FromString("UNKNOWN");
+    }
+    PyErr_Format(PyExc_SystemError, "picosat return value: %d", q->res);
+    return NULL;
+}
+
+static PyObject* solver_solve_batch(solverobject *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    PyObject *queries, *seq = NULL, *result = NULL, *item;
+    unsigned long long prop_limit = self->prop_limit;
+    batchworker *workers = NULL, *w;
+    batchquery *qs = NULL;
+    Py_ssize_t nq = 0, i, k, n;
+    int threads = 1, models = 0, failed = 0, nw, g, *lits;
+    char *skip = NULL;
+    static char* kwlist[] = {"queries", "threads", "models", "failed",
+                             "prop_limit", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,
+                                     "O|iiiK:solve_assumptions_batch",
+                                     kwlist, &queries, &threads, &models,
+                                     &failed, &prop_limit))
+        return NULL;
+
+    if (threads < 1) {
+        PyErr_SetString(PyExc_ValueError, "positive number of threads "
+                        "expected");
+        return NULL;
+    }
+    if (solver_check_busy(self) < 0)
+        return NULL;
+
+    seq = PySequence_Fast(queries, "sequence of assumptions expected");
+    if (seq == NULL)
+        return NULL;
+    nq = PySequence_Fast_GET_SIZE(seq);
+
+    qs = PyMem_Malloc((nq ? nq : 1) * sizeof(batchquery));
+    if (qs == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (i = 0; i < nq; i++) {
+        qs[i].lits = NULL;
+        qs[i].model = NULL;
+        qs[i].failed = NULL;
+    }
+    for (i = 0; i < nq; i++) {
+        n = get_lits(PySequence_Fast_GET_ITEM(seq, i), &lits);
+        if (n < 0)
+            goto done;
+        qs[i].lits = lits;
+        if (solver_check_vars(self, lits, n) < 0)
+            goto done;
+        lits = PyMem_Realloc(lits, (n + 1) * sizeof(int));
+        if (lits == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        qs[i].lits = lits;
+        qs[i].lits[n] = 0;
+        qsort(lits, n, sizeof(int), cmp_lits_by_var);
+        qs[i].index = i;
+        qs[i].res = PICOSAT_UNKNOWN;
+    }
+    qsort(qs, nq, sizeof(batchquery), cmp_queries);
+
+    /* the clauses of disabled groups are left out in the copies */
+    n = picosat_variables(self->picosat);
+    skip = PyMem_Malloc(n + 1);
+    if (skip == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    memset(skip, 0, n + 1);
+    for (k = 0; k < self->ncnf; k++) {
+        g = self->cnf[k];
+        if (g && !skip[g] && !picosat_group_enabled(self->picosat, g))
+            skip[g] = 1;
+        while (self->cnf[++k])
+            ;
+    }
+
+    /* each worker gets a contiguous range of the sorted queries, and the
+       first one uses the solver itself */
+    nw = nq < threads ? (int) (nq ? nq : 1) : threads;
+    workers = PyMem_Malloc(nw * sizeof(batchworker));
+    if (workers == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (k = 0; k < nw; k++) {
+        w = workers + k;
+        w->solver = self;
+        w->skip = skip;
+        w->copy = k > 0;
+        w->begin = qs + k * nq / nw;
+        w->end = qs + (k + 1) * nq / nw;
+        w->prop_limit = prop_limit;
+        w->models = models;
+        w->failed = failed;
+        w->nomem = 0;
+        w->done = NULL;
+        if (w->copy) {
+            w->picosat = picosat_init();
+            picosat_copy_options(w->picosat, self->picosat);
+            picosat_adjust(w->picosat, self->nvars);
+            w->done = PyThread_allocate_lock();
+            if (w->done)
+                PyThread_acquire_lock(w->done, WAIT_LOCK);
+        }
+        else
+            w->picosat = self->picosat;
+    }
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    for (k = 1; k < nw; k++) {
+        w = workers + k;
+        if (w->done == NULL ||
+                PyThread_start_new_thread(batch_thread, w) == (unsigned long) -1)
+        {
+            /* run it later in this thread instead */
+            if (w->done)
+                PyThread_release_lock(w->done);
+            w->copy = -1;
+        }
+    }
+    batch_run(workers);
+    for (k = 1; k < nw; k++) {
+        w = workers + k;
+        if (w->copy < 0) {
+            w->copy = 1;
+            batch_run(w);
+        }
+        else
+            PyThread_acquire_lock(w->done, WAIT_LOCK);
+    }
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    for (k = 0; k < nw; k++) {
+        w = workers + k;
+        if (w->copy) {
+            picosat_reset(w->picosat);
+            if (w->done)
+                PyThread_free_lock(w->done);
+        }
+        if (w->nomem)
+            PyErr_NoMemory();
+    }
+    if (PyErr_Occurred())
+        goto done;
+
+    result = PyList_New(nq);
+    if (result == NULL)
+        goto done;
+    for (i = 0; i < nq; i++) {
+        item = batch_result(qs + i, self->nvars);
+        if (item == NULL) {
+            Py_CLEAR(result);
+            goto done;
+        }
+        PyList_SET_ITEM(result, qs[i].index, item);
+    }
+
+ done:
+    for (i = 0; qs && i < nq; i++) {
+        if (qs[i].lits)
+            PyMem_Free(qs[i].lits);
+        free(qs[i].model);
+        free(qs[i].failed);
+    }
+    if (qs)
+        PyMem_Free(qs);
+    if (workers)
+        PyMem_Free(workers);
+    if (skip)
+        PyMem_Free(skip);
+    Py_XDECREF(seq);
+    return result;
+}
+
+#ifdef HAVE_FORK
+/* Splitting of the clauses into cubes (conjunctions of literals), which
+   together cover all assignments.  Each branch assumes the most frequent
+   variable, which is neither assumed nor implied yet, both ways, and
+   branches which propagate to a conflict are left out. */
+typedef struct {
+    PicoSAT *picosat;
+    int nvars, depth;
+    unsigned *score;            /* occurrences of each variable */
+    signed char *mark;          /* variables of the current branch */
+    int *cube;                  /* literals of the branch (zero terminated) */
+    flatcnf cubes;              /* all cubes, each zero terminated */
+} cuber;
+
+static int cube_split(cuber *c, int level)
+{
+    const int *p;
+    int v, best = 0;
+
+    if (picosat_propagate(c->picosat, c->cube) == PICOSAT_UNSATISFIABLE)
+        return 0;
+
+    if (level < c->depth) {
+        for (p = picosat_propagated(c->picosat); *p; p++)
+            c->mark[abs(*p)] = 1;
+        for (v = 1; v <= c->nvars; v++)
+            if (!c->mark[v] && !picosat_deref_toplevel(c->picosat, v) &&
+                    (!best || c->score[v] > c->score[best]))
+                best = v;
+        for (p = picosat_propagated(c->picosat); *p; p++)
+            c->mark[abs(*p)] = 0;
+    }
+    if (best == 0) {
+        for (p = c->cube; *p; p++)
+            if (flat_push(&c->cubes, *p) < 0)
+                return -1;
+        return flat_push(&c->cubes, 0);
+    }
+
+    c->mark[best] = 1;
+    c->cube[level + 1] = 0;
+    c->cube[level] = best;
+    if (cube_split(c, level + 1) < 0)
+        return -1;
+    c->cube[level] = -best;
+    if (cube_split(c, level + 1) < 0)
+        return -1;
+    c->cube[level] = 0;
+    c->mark[best] = 0;
+    return 0;
+}
+
+/* A worker process of solve_cubes, and the range of cubes it owns */
+typedef struct {
+    pid_t pid;
+    int fd;                     /* socket of the coordinator */
+    Py_ssize_t next, end;       /* cubes not handed out yet */
+    Py_ssize_t current;         /* cube being solved (or -1) */
+} cubeworker;
+
+/* Send or receive all 'n' bytes of 'buf' (retrying after signals) */
+static int sock_send(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char *) buf;
+    ssize_t k;
+
+    while (n) {
+        k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return -1;
+        p += k;
+        n -= (size_t) k;
+    }
+    return 0;
+}
+
+static int sock_recv(int fd, void *buf, size_t n)
+{
+    char *p = (char *) buf;
+    ssize_t k;
+
+    while (n) {
+        k = recv(fd, p, n, 0);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return -1;
+        p += k;
+        n -= (size_t) k;
+    }
+    return 0;
+}
+
+/* Main loop of a worker process, which solves the cubes (given by their
+   index) it receives from the coordinator with its own copy of picosat,
+   and replies with the result and the model.  It never returns, and does
+   not call any Python functions. */
+static void cube_worker(PicoSAT *picosat, int fd, const int *cubes,
+                        const Py_ssize_t *starts, int nvars,
+                        unsigned long long prop_limit)
+{
+    signed char *model;
+    Py_ssize_t i;
+    int res, v;
+
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    signal(SIGINT, SIG_IGN);    /* the coordinator handles interrupts */
+
+    model = malloc(nvars + 1);
+    while (model && sock_recv(fd, &i, sizeof(i)) == 0 && i >= 0) {
+        picosat_set_propagation_limit(picosat, prop_limit ?
+                picosat_propagations(picosat) + prop_limit : ~0ull);
+        res = picosat_sat_assuming(picosat, cubes + starts[i], -1);
+        if (sock_send(fd, &res, sizeof(res)) < 0)
+            break;
+        if (res == PICOSAT_SATISFIABLE) {
+            for (v = 1; v <= nvars; v++)
+                model[v] = picosat_deref(picosat, v) > 0 ? 1 : -1;
+            if (sock_send(fd, model + 1, nvars) < 0)
+                break;
+        }
+    }
+    _exit(0);
+}
+
+/* Hand the next cube to the worker 'w': the first one of its own range,
+   or else it steals the second half of the largest range of the others.
+   Ranges are contiguous in the order of the cubes, such that each worker
+   solves cubes with common prefixes after each other. */
+static int cube_assign(cubeworker *workers, int nw, cubeworker *w)
+{
+    cubeworker *v = w;
+    Py_ssize_t mid;
+    int k;
+
+    if (w->next == w->end) {
+        for (k = 0; k < nw; k++)
+            if (workers[k].end - workers[k].next > v->end - v->next)
+                v = workers + k;
+        if (v->next == v->end) {
+            w->current = -1;
+            return 0;
+        }
+        mid = v->next + (v->end - v->next) / 2;
+        w->next = mid;
+        w->end = v->end;
+        v->end = mid;
+    }
+    w->current = w->next++;
+    return sock_send(w->fd, &w->current, sizeof(w->current));
+}
+
+static PyObject* solver_solve_cubes(solverobject *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    unsigned long long prop_limit = self->prop_limit;
+    PyObject *result = NULL;
+    cuber c;
+    batchquery found;           /* the satisfiable cube */
+    cubeworker *workers = NULL, *w;
+    struct pollfd *fds = NULL;
+    Py_ssize_t *starts = NULL, nc, i, k;
+    int processes, depth = -1, nw = 0, res, n, v, unknown = 0;
+    int interrupted = 0, failed = 0, err = 0, sv[2];
+    pid_t pid;
+    static char* kwlist[] = {"processes", "depth", "prop_limit", NULL};
+
+    n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    processes = n > 0 ? n : 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiK:solve_cubes",
+                                     kwlist, &processes, &depth,
+                                     &prop_limit))
+        return NULL;
+
+    if (processes < 1) {
+        PyErr_SetString(PyExc_ValueError, "positive number of processes "
+                        "expected");
+        return NULL;
+    }
+    if (depth < -1 || depth > 20) {
+        PyErr_SetString(PyExc_ValueError, "depth between 0 and 20 expected");
+        return NULL;
+    }
+    if (depth < 0)              /* about 16 cubes for each process */
+        for (depth = 4; depth < 20 && (1 << (depth - 4)) < processes; depth++)
+            ;
+    if (solver_check_busy(self) < 0)
+        return NULL;
+
+    memset(&c, 0, sizeof(c));
+    found.res = PICOSAT_UNKNOWN;
+    found.model = NULL;
+    found.failed = NULL;
+    c.picosat = self->picosat;
+    c.nvars = self->nvars;
+    c.depth = depth;
+    c.score = PyMem_Malloc((self->nvars + 1) * sizeof(unsigned));
+    c.mark = PyMem_Malloc(self->nvars + 1);
+    c.cube = PyMem_Malloc((depth + 1) * sizeof(int));
+    if (c.score == NULL || c.mark == NULL || c.cube == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    memset(c.score, 0, (self->nvars + 1) * sizeof(unsigned));
+    memset(c.mark, 0, self->nvars + 1);
+    c.cube[0] = 0;
+    for (k = 0; k < self->ncnf; k++)    /* skip the group of each clause */
+        while ((v = abs(self->cnf[++k])))
+            if (v <= self->nvars)
+                c.score[v]++;
+    if (cube_split(&c, 0) < 0)
+        goto done;
+
+    nc = c.cubes.nclauses;
+    if (nc == 0) {
+        result = PyUnicode_FromString("UNSAT");
+        goto done;
+    }
+    starts = PyMem_Malloc(nc * sizeof(Py_ssize_t));
+    nw = nc < processes ? (int) nc : processes;
+    workers = PyMem_Malloc(nw * sizeof(cubeworker));
+    fds = PyMem_Malloc(nw * sizeof(struct pollfd));
+    if (starts == NULL || workers == NULL || fds == NULL) {
+        nw = 0;
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (i = k = 0; i < nc; i++) {
+        starts[i] = k;
+        while (c.cubes.lits[k++])
+            ;
+    }
+
+    /* the workers inherit the solver and the cubes, and initially own
+       equal ranges of the cubes */
+    for (n = 0; n < nw; n++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            break;
+        }
+        pid = fork();
+        if (pid < 0) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            close(sv[0]);
+            close(sv[1]);
+            break;
+        }
+        if (pid == 0) {
+            close(sv[0]);
+            for (k = 0; k < n; k++)
+                close(workers[k].fd);
+            cube_worker(self->picosat, sv[1], c.cubes.lits, starts,
+                        self->nvars, prop_limit);
+        }
+        close(sv[1]);
+        w = workers + n;
+        w->pid = pid;
+        w->fd = sv[0];
+        w->next = n * nc / nw;
+        w->end = (n + 1) * nc / nw;
+        w->current = -1;
+    }
+    if (n < nw) {
+        nw = n;
+        goto done;
+    }
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    for (n = 0; n < nw && !failed; n++)
+        if (cube_assign(workers, nw, workers + n) < 0)
+            failed = 1;
+    while (!failed && found.res != PICOSAT_SATISFIABLE) {
+        for (n = k = 0; n < nw; n++) {
+            fds[n].fd = workers[n].current < 0 ? -1 : workers[n].fd;
+            fds[n].events = POLLIN;
+            k += workers[n].current >= 0;
+        }
+        if (k == 0)             /* all cubes are solved */
+            break;
+        if (poll(fds, nw, 100) <= 0) {
+            if (errno != EINTR && errno != EAGAIN && errno) {
+                err = errno;
+                failed = 1;
+            }
+            errno = 0;
+            Py_BLOCK_THREADS
+            interrupted = PyErr_CheckSignals() < 0;
+            Py_UNBLOCK_THREADS
+            if (interrupted)
+                break;
+            continue;
+        }
+        for (n = 0; n < nw && !failed; n++) {
+            w = workers + n;
+            if (fds[n].fd < 0 || fds[n].revents == 0)
+                continue;
+            if (sock_recv(w->fd, &res, sizeof(res)) < 0) {
+                failed = 1;
+                break;
+            }
+            if (res == PICOSAT_SATISFIABLE) {
+                found.model = malloc(self->nvars + 1);
+                if (found.model == NULL ||
+                        sock_recv(w->fd, found.model + 1, self->nvars) < 0) {
+                    err = found.model ? 0 : ENOMEM;
+                    failed = 1;
+                    break;
+                }
+                found.res = res;
+                w->current = -1;
+                break;
+            }
+            if (res == PICOSAT_UNKNOWN)
+                unknown = 1;
+            if (cube_assign(workers, nw, w) < 0)
+                failed = 1;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    if (interrupted)
+        goto done;
+    if (failed) {
+        if (err) {
+            errno = err;
+            PyErr_SetFromErrno(PyExc_OSError);
+        }
+        else
+            PyErr_SetString(PyExc_RuntimeError, "cube worker failed");
+        goto done;
+    }
+    if (found.res != PICOSAT_SATISFIABLE)
+        found.res = unknown ? PICOSAT_UNKNOWN : PICOSAT_UNSATISFIABLE;
+    result = batch_result(&found, self->nvars);
+
+ done:
+    /* idle workers exit when told so, busy ones are killed */
+    Py_BEGIN_ALLOW_THREADS
+    for (n = 0; n < nw; n++) {
+        w = workers + n;
+        if (w->current >= 0)
+            kill(w->pid, SIGKILL);
+        else
+            sock_send(w->fd, &w->current, sizeof(w->current));
+        close(w->fd);
+    }
+    for (n = 0; n < nw; n++)
+        while (waitpid(workers[n].pid, NULL, 0) < 0 && errno == EINTR)
+            ;
+    Py_END_ALLOW_THREADS
+    free(found.model);
+    if (c.cubes.lits)
+        PyMem_Free(c.cubes.lits);
+    if (c.score)
+        PyMem_Free(c.score);
+    if (c.mark)
+        PyMem_Free(c.mark);
+    if (c.cube)
+        PyMem_Free(c.cube);
+    if (starts)
+        PyMem_Free(starts);
+    if (workers)
+        PyMem_Free(workers);
+    if (fds)
+        PyMem_Free(fds);
+    return result;
+}
+#endif  /* HAVE_FORK */
+
+static PyObject* solver_set_option(solverobject *self, PyObject *args)
+{
+    const char *name;
+    PyObject *value;
+
+    if (!PyArg_ParseTuple(args, "sO:set_option", &name, &value))
+        return NULL;
+
+    if (solver_check_busy(self) < 0 ||
+            set_option(self->picosat, name, value) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject* solver_get_option(solverobject *self, PyObject *args)
+{
+    const char *name;
+
+    if (!PyArg_ParseTuple(args, "s:get_option", &name))
+        return NULL;
+
+    if (!picosat_has_option(name)) {
+        PyErr_Format(PyExc_ValueError, "unknown option '%s'", name);
+        return NULL;
+    }
+    return PyInt_FromLong((long) picosat_get_option(self->picosat, name));
+}
+
+static PyObject* solver_add_group(solverobject *self);
+
+static PyMethodDef solver_methods[] = {
+    {"add_clause",  (PyCFunction) solver_add_clause,  METH_O},
+    {"add_group",   (PyCFunction) solver_add_group,   METH_NOARGS},
+    {"add_clauses", (PyCFunction) solver_add_clauses, METH_O},
+    {"add_named_clauses", (PyCFunction) solver_add_named_clauses, METH_O},
+    {"solve",       (PyCFunction) solver_solve,
+                                          METH_VARARGS | METH_KEYWORDS},
+    {"solve_named", (PyCFunction) solver_solve_named,
+                                          METH_VARARGS | METH_KEYWORDS},
+    {"propagate",   (PyCFunction) solver_propagate,
+                                          METH_VARARGS | METH_KEYWORDS},
+    {"solve_assumptions_batch", (PyCFunction) solver_solve_batch,
+                                          METH_VARARGS | METH_KEYWORDS},
+#ifdef HAVE_FORK
+    {"solve_cubes", (PyCFunction) solver_solve_cubes,
+                                          METH_VARARGS | METH_KEYWORDS},
+#endif
+    {"set_option",  (PyCFunction) solver_set_option,  METH_VARARGS},
+    {"get_option",  (PyCFunction) solver_get_option,  METH_VARARGS},
+    {NULL,          NULL}  /* sentinel */
+};
+
+static PyGetSetDef solver_getset[] = {
+    {"varmap", (getter) solver_varmap, NULL, NULL, NULL},
+    {NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot solver_slots[] = {
+    {Py_tp_dealloc, solver_dealloc},
+    {Py_tp_methods, solver_methods},
+    {Py_tp_getset, solver_getset},
+    {Py_tp_new, solver_new},
+    {0, NULL}
+};
+
+static PyType_Spec solver_spec = {
+    "pycosat.Solver", sizeof(solverobject), 0,
+    Py_TPFLAGS_DEFAULT, solver_slots
+};
+#else
+static PyTypeObject Solver_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.Solver",                         /* tp_name */
+    sizeof(solverobject),                     /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) solver_dealloc,              /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    0,                                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    solver_methods,                           /* tp_methods */
+    0,                                        /* tp_members */
+    solver_getset,                            /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    solver_new,                               /* tp_new */
+};
+#endif
+
+/************************** Clause group object *************************/
+
+typedef struct {
+    PyObject_HEAD
+    solverobject *solver;
+    int group;                  /* picosat group, zero after delete */
+} groupobject;
+
+static PyObject* solver_add_group(solverobject *self)
+{
+    groupobject *g;
+
+    if (solver_check_busy(self) < 0)
+        return NULL;
+
+    g = PyObject_New(groupobject,
+                     type_state(Py_TYPE(self))->ClauseGroup_Type);
+    if (g == NULL)
+        return NULL;
+
+    Py_INCREF(self);
+    g->solver = self;
+    g->group = picosat_new_group(self->picosat);
+    return (PyObject *) g;
+}
+
+static int group_check(groupobject *g)
+{
+    if (g->group == 0) {
+        PyErr_SetString(PyExc_ValueError, "clause group was deleted");
+        return -1;
+    }
+    return solver_check_busy(g->solver);
+}
+
+static PyObject* group_add_clause(groupobject *g, PyObject *clause)
+{
+    int res;
+
+    if (group_check(g) < 0)
+        return NULL;
+
+    picosat_set_group(g->solver->picosat, g->group);
+    g->solver->group = g->group;
+    res = solver_add(g->solver, clause);
+    picosat_set_group(g->solver->picosat, 0);
+    g->solver->group = 0;
+    if (res < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject* group_add_clauses(groupobject *g, PyObject *clauses)
+{
+    int res;
+
+    if (group_check(g) < 0)
+        return NULL;
+
+    picosat_set_group(g->solver->picosat, g->group);
+    g->solver->group = g->group;
+    res = solver_add_all(g->solver, clauses);
+    picosat_set_group(g->solver->picosat, 0);
+    g->solver->group = 0;
+    if (res < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject* group_enable(groupobject *g)
+{
+    if (group_check(g) < 0)
+        return NULL;
+    picosat_enable_group(g->solver->picosat, g->group);
+    Py_RETURN_NONE;
+}
+
+static PyObject* group_disable(groupobject *g)
+{
+    if (group_check(g) < 0)
+        return NULL;
+    picosat_disable_group(g->solver->picosat, g->group);
+    Py_RETURN_NONE;
+}
+
+static PyObject* group_delete(groupobject *g)
+{
+    if (group_check(g) < 0)
+        return NULL;
+    picosat_delete_group(g->solver->picosat, g->group);
+    solver_unrecord(g->solver, g->group);
+    g->group = 0;
+    Py_RETURN_NONE;
+}
+
+static void group_dealloc(groupobject *g)
+{
+    PyTypeObject *tp = Py_TYPE(g);
+
+    Py_DECREF(g->solver);
+    PyObject_Del(g);
+    RELEASE_TYPE(tp);
+}
+
+static PyMethodDef group_methods[] = {
+    {"add_clause",  (PyCFunction) group_add_clause,  METH_O},
+    {"add_clauses", (PyCFunction) group_add_clauses, METH_O},
+    {"enable",      (PyCFunction) group_enable,      METH_NOARGS},
+    {"disable",     (PyCFunction) group_disable,     METH_NOARGS},
+    {"delete",      (PyCFunction) group_delete,      METH_NOARGS},
+    {NULL,          NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot group_slots[] = {
+    {Py_tp_dealloc, group_dealloc},
+    {Py_tp_methods, group_methods},
+    {0, NULL}
+};
+
+static PyType_Spec group_spec = {
+    "pycosat.ClauseGroup", sizeof(groupobject), 0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION, group_slots
+};
+#else
+static PyTypeObject ClauseGroup_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.ClauseGroup",                    /* tp_name */
+    sizeof(groupobject),                      /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) group_dealloc,               /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    0,                                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    group_methods,                            /* tp_methods */
+};
+#endif
+
+/**************************** d-DNNF circuit ****************************/
+
+/* A decision-DNNF circuit of the clauses, which is compiled by a DPLL
+   search with component caching.  Every branch of the search is checked
+   with picosat (such that the clauses learned by picosat are shared by
+   all branches), and its implied literals are obtained from picosat's
+   unit propagation.  The nodes are stored in topological order (children
+   before their parents), such that all queries are a single pass over the
+   nodes, without any calls to picosat. */
+
+#define DNNF_FALSE  0
+#define DNNF_TRUE   1
+#define DNNF_LIT    2       /* the literal a */
+#define DNNF_AND    3       /* b children at kids[a] and c free variables
+                               after them */
+#define DNNF_DEC    4       /* (a and node b) or (-a and node c) */
+
+typedef struct {
+    int kind, a, b, c;
+} dnnfnode;
+
+typedef struct {
+    int refs;                   /* number of objects sharing the circuit */
+    int nvars;
+    dnnfnode *nodes;
+    int nnodes, sznodes;
+    int *kids;
+    int nkids, szkids;
+    int root;
+} circuit;
+
+/* Make sure the array '*p' of '*size' elements of 'elem' bytes has room
+   for 'need' elements */
+static int reserve(void **p, int *size, int need, size_t elem)
+{
+    void *q;
+    int n = *size ? *size : 16;
+
+    if (need <= *size)
+        return 0;
+    while (n < need)
+        n *= 2;
+    q = PyMem_Realloc(*p, n * elem);
+    if (q == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    *p = q;
+    *size = n;
+    return 0;
+}
+
+static int new_node(circuit *c, int kind, int a, int b, int d)
+{
+    dnnfnode *node;
+
+    if (reserve((void **) &c->nodes, &c->sznodes, c->nnodes + 1,
+                sizeof(dnnfnode)) < 0)
+        return -1;
+    node = c->nodes + c->nnodes;
+    node->kind = kind;
+    node->a = a;
+    node->b = b;
+    node->c = d;
+    return c->nnodes++;
+}
+
+static void circuit_release(circuit *c)
+{
+    if (c == NULL || --c->refs > 0)
+        return;
+    PyMem_Free(c->nodes);
+    PyMem_Free(c->kids);
+    PyMem_Free(c);
+}
+
+typedef struct {
+    circuit *c;
+    PicoSAT *picosat;
+    int nclauses;
+    int *lits, *start;          /* clause i is lits[start[i]] up to
+                                   lits[start[i + 1]] */
+    signed char *val;           /* current assignment of the variables */
+    int *path, npath;           /* decisions (zero terminated) */
+    int *trail, ntrail;         /* assigned variables */
+    int *litnode;               /* node of each literal, or -1 */
+    int *parent, *comp, *cnt;   /* temporary per variable */
+    int *table, sztable, ntable;  /* component cache (key, node) */
+    int *keys, nkeys, szkeys;
+} compiler;
+
+static int compile_component(compiler *cp, const int *vars, int nv,
+                             const int *cls, int nc);
+
+static int lit_node(compiler *cp, int lit)
+{
+    int *p = cp->litnode + 2 * abs(lit) + (lit < 0);
+
+    if (*p < 0)
+        *p = new_node(cp->c, DNNF_LIT, lit, 0, 0);
+    return *p;
+}
+
+static void assign_var(compiler *cp, int lit)
+{
+    cp->val[abs(lit)] = lit > 0 ? 1 : -1;
+    cp->trail[cp->ntrail++] = abs(lit);
+}
+
+static int find_var(int *parent, int v)
+{
+    while (parent[v] != v)
+        v = parent[v] = parent[parent[v]];
+    return v;
+}
+
+/* Return the AND node of the literals 'implied' and the components of the
+   clauses 'cls' (which are not satisfied yet) over the unassigned
+   variables of 'vars'.  The variables which do not occur in any of these
+   clauses are free. */
+static int build_and(compiler *cp, const int *vars, int nv,
+                     const int *cls, int nc,
+                     const int *implied, int nimplied)
+{
+    circuit *c = cp->c;
+    int *buf = NULL, *kept, *cvars, *ccls, *cstart, *kids;
+    int nkept = 0, ncomp = 0, nfree = 0, nkids = 0;
+    int i, j, k, v, r, *p, *q, satisfied, node = -1;
+
+    /* kept, cvars and ccls, cstart (ncomp + 1 offsets for both) and kids
+       need at most nc, nv, nc, 2 * (nv + 1) and nimplied + nv + nv */
+    buf = PyMem_Malloc((3 * nc + 5 * nv + 2 + nimplied) * sizeof(int));
+    if (buf == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    kept = buf;
+    ccls = kept + nc;
+    cvars = ccls + nc;
+    cstart = cvars + nv;
+    kids = cstart + 2 * (nv + 1);
+
+    for (i = 0; i < nv; i++) {
+        v = vars[i];
+        cp->parent[v] = v;
+        cp->cnt[v] = 0;
+        cp->comp[v] = -1;
+    }
+
+    /* keep the clauses which are not satisfied and join their variables */
+    for (i = 0; i < nc; i++) {
+        p = cp->lits + cp->start[cls[i]];
+        q = cp->lits + cp->start[cls[i] + 1];
+        for (satisfied = 0, j = 0; p + j < q; j++)
+            if (cp->val[abs(p[j])] == (p[j] > 0 ? 1 : -1))
+                satisfied = 1;
+        if (satisfied)
+            continue;
+        kept[nkept++] = cls[i];
+        for (r = 0; p < q; p++) {
+            v = abs(*p);
+            if (cp->val[v])
+                continue;
+            cp->cnt[v] = 1;
+            if (r)
+                cp->parent[find_var(cp->parent, v)] = find_var(cp->parent, r);
+            else
+                r = v;
+        }
+    }
+
+    /* number the components and count their variables and clauses */
+    for (i = 0; i < 2 * (nv + 1); i++)
+        cstart[i] = 0;
+    for (i = 0; i < nv; i++) {
+        v = vars[i];
+        if (cp->val[v])
+            continue;
+        if (cp->cnt[v] == 0) {
+            kids[nimplied + nv + nfree++] = v;
+            continue;
+        }
+        r = find_var(cp->parent, v);
+        if (cp->comp[r] < 0)
+            cp->comp[r] = ncomp++;
+        cstart[cp->comp[r] + 1]++;
+    }
+    for (i = 0; i < nkept; i++) {
+        for (p = cp->lits + cp->start[kept[i]]; cp->val[abs(*p)]; p++)
+            ;
+        cstart[nv + 1 + cp->comp[find_var(cp->parent, abs(*p))] + 1]++;
+    }
+    for (k = 0; k < ncomp; k++) {
+        cstart[k + 1] += cstart[k];
+        cstart[nv + 1 + k + 1] += cstart[nv + 1 + k];
+    }
+
+    /* distribute variables and clauses, which keeps them sorted */
+    for (i = 0; i < nv; i++) {
+        v = vars[i];
+        if (cp->val[v] == 0 && cp->cnt[v])
+            cvars[cstart[cp->comp[find_var(cp->parent, v)]]++] = v;
+    }
+    for (i = 0; i < nkept; i++) {
+        for (p = cp->lits + cp->start[kept[i]]; cp->val[abs(*p)]; p++)
+            ;
+        k = nv + 1 + cp->comp[find_var(cp->parent, abs(*p))];
+        ccls[cstart[k]++] = kept[i];
+    }
+    /* the offsets are now those of the next component */
+    for (k = ncomp; k > 0; k--) {
+        cstart[k] = cstart[k - 1];
+        cstart[nv + 1 + k] = cstart[nv + 1 + k - 1];
+    }
+    cstart[0] = cstart[nv + 1] = 0;
+
+    for (i = 0; i < nimplied; i++) {
+        if ((kids[nkids++] = lit_node(cp, implied[i])) < 0)
+            goto done;
+    }
+    for (k = 0; k < ncomp; k++) {
+        r = compile_component(cp, cvars + cstart[k],
+                              cstart[k + 1] - cstart[k],
+                              ccls + cstart[nv + 1 + k],
+                              cstart[nv + 1 + k + 1] - cstart[nv + 1 + k]);
+        if (r < 0)
+            goto done;
+        if (c->nodes[r].kind == DNNF_FALSE) {
+            node = DNNF_FALSE;
+            goto done;
+        }
+        kids[nkids++] = r;
+    }
+    /* move the free variables right behind the children */
+    for (i = 0; i < nfree; i++)
+        kids[nkids + i] = kids[nimplied + nv + i];
+
+    if (nkids + nfree == 0) {
+        node = DNNF_TRUE;
+        goto done;
+    }
+    if (nkids == 1 && nfree == 0) {
+        node = kids[0];
+        goto done;
+    }
+    if (reserve((void **) &c->kids, &c->szkids, c->nkids + nkids + nfree,
+                sizeof(int)) < 0)
+        goto done;
+    node = new_node(c, DNNF_AND, c->nkids, nkids, nfree);
+    if (node >= 0) {
+        memcpy(c->kids + c->nkids, kids, (nkids + nfree) * sizeof(int));
+        c->nkids += nkids + nfree;
+    }
+
+ done:
+    PyMem_Free(buf);
+    return node;
+}
+
+/* Check the current decisions with picosat (-1 on errors, 0 if they are
+   inconsistent and 1 otherwise) */
+static int check_path(compiler *cp)
+{
+    int i, res;
+
+    for (i = 0; i < cp->npath; i++)
+        picosat_assume(cp->picosat, cp->path[i]);
+    res = picosat_sat(cp->picosat, -1);
+    if (res == PICOSAT_UNKNOWN) {
+        PyErr_SetString(PyExc_RuntimeError, "propagation limit reached");
+        return -1;
+    }
+    return res == PICOSAT_SATISFIABLE;
+}
+
+static int in_vars(const int *vars, int nv, int v)
+{
+    int lo = 0, hi = nv, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (vars[mid] < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < nv && vars[lo] == v;
+}
+
+/* Compile the branch of the decision 'lit' of a component.  Since the
+   decisions leading to the component are consistent, and the other
+   components are independent, the result only depends on the component
+   itself, even though the check and the propagation use all clauses. */
+static int compile_branch(compiler *cp, int lit, const int *vars, int nv,
+                          const int *cls, int nc)
+{
+    const int *p;
+    int *implied, nimplied = 0, mark = cp->ntrail, node, res;
+
+    cp->path[cp->npath++] = lit;
+    cp->path[cp->npath] = 0;
+
+    res = check_path(cp);
+    if (res <= 0) {
+        node = res < 0 ? -1 : DNNF_FALSE;
+        goto done;
+    }
+
+    implied = PyMem_Malloc(nv * sizeof(int));
+    if (implied == NULL) {
+        PyErr_NoMemory();
+        node = -1;
+        goto done;
+    }
+    assign_var(cp, lit);
+    picosat_propagate(cp->picosat, cp->path);
+    for (p = picosat_propagated(cp->picosat); *p; p++)
+        if (cp->val[abs(*p)] == 0 && in_vars(vars, nv, abs(*p))) {
+            assign_var(cp, *p);
+            implied[nimplied++] = *p;
+        }
+    node = build_and(cp, vars, nv, cls, nc, implied, nimplied);
+    PyMem_Free(implied);
+
+ done:
+    while (cp->ntrail > mark)
+        cp->val[cp->trail[--cp->ntrail]] = 0;
+    cp->path[--cp->npath] = 0;
+    return node;
+}
+
+static unsigned hash_key(const int *key, int n)
+{
+    unsigned h = 2166136261u;
+    int i;
+
+    for (i = 0; i < n; i++)
+        h = (h ^ (unsigned) key[i]) * 16777619u;
+    return h;
+}
+
+/* Return the slot of the key (n, vars, cls) in the component cache */
+static int *cache_slot(compiler *cp, const int *vars, int nv,
+                       const int *cls, int nc)
+{
+    unsigned h = hash_key(vars, nv) ^ (hash_key(cls, nc) * 31u);
+    int *slot, *key;
+
+    for (h &= cp->sztable - 1;; h = (h + 1) & (cp->sztable - 1)) {
+        slot = cp->table + 2 * h;
+        if (slot[0] < 0)
+            return slot;
+        key = cp->keys + slot[0];
+        if (key[0] == nv && key[1] == nc &&
+                memcmp(key + 2, vars, nv * sizeof(int)) == 0 &&
+                memcmp(key + 2 + nv, cls, nc * sizeof(int)) == 0)
+            return slot;
+    }
+}
+
+static int cache_grow(compiler *cp)
+{
+    int *old = cp->table, sz = cp->sztable, i, *key, *slot;
+
+    cp->sztable = sz ? 2 * sz : 1024;
+    cp->table = PyMem_Malloc(2 * cp->sztable * sizeof(int));
+    if (cp->table == NULL) {
+        cp->table = old;
+        cp->sztable = sz;
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < 2 * cp->sztable; i++)
+        cp->table[i] = -1;
+    for (i = 0; i < sz; i++)
+        if (old[2 * i] >= 0) {
+            key = cp->keys + old[2 * i];
+            slot = cache_slot(cp, key + 2, key[0], key + 2 + key[0], key[1]);
+            slot[0] = old[2 * i];
+            slot[1] = old[2 * i + 1];
+        }
+    PyMem_Free(old);
+    return 0;
+}
+
+/* Compile the component of the variables 'vars' and clauses 'cls' (both
+   sorted), by deciding its most frequent variable */
+static int compile_component(compiler *cp, const int *vars, int nv,
+                             const int *cls, int nc)
+{
+    int *slot, *p, *q, i, v, best, hi, lo, node;
+
+    if (2 * (cp->ntable + 1) > cp->sztable && cache_grow(cp) < 0)
+        return -1;
+    slot = cache_slot(cp, vars, nv, cls, nc);
+    if (slot[0] >= 0)
+        return slot[1];
+
+    for (i = 0; i < nv; i++)
+        cp->cnt[vars[i]] = 0;
+    for (i = 0; i < nc; i++) {
+        p = cp->lits + cp->start[cls[i]];
+        q = cp->lits + cp->start[cls[i] + 1];
+        for (; p < q; p++)
+            if (cp->val[abs(*p)] == 0)
+                cp->cnt[abs(*p)]++;
+    }
+    for (best = vars[0], i = 1; i < nv; i++)
+        if (cp->cnt[vars[i]] > cp->cnt[best])
+            best = vars[i];
+    v = best;
+
+    hi = compile_branch(cp, v, vars, nv, cls, nc);
+    if (hi < 0)
+        return -1;
+    lo = compile_branch(cp, -v, vars, nv, cls, nc);
+    if (lo < 0)
+        return -1;
+
+    if (hi == DNNF_FALSE && lo == DNNF_FALSE)
+        node = DNNF_FALSE;
+    else
+        node = new_node(cp->c, DNNF_DEC, v, hi, lo);
+    if (node < 0)
+        return -1;
+
+    /* the slot has to be found again, as the cache may have grown */
+    if (reserve((void **) &cp->keys, &cp->szkeys, cp->nkeys + 2 + nv + nc,
+                sizeof(int)) < 0)
+        return -1;
+    slot = cache_slot(cp, vars, nv, cls, nc);
+    slot[0] = cp->nkeys;
+    slot[1] = node;
+    cp->ntable++;
+    cp->keys[cp->nkeys++] = nv;
+    cp->keys[cp->nkeys++] = nc;
+    memcpy(cp->keys + cp->nkeys, vars, nv * sizeof(int));
+    cp->nkeys += nv;
+    memcpy(cp->keys + cp->nkeys, cls, nc * sizeof(int));
+    cp->nkeys += nc;
+    return node;
+}
+
+/* Read the clauses (a list), which have been added to picosat already */
+static int compiler_clauses(compiler *cp, PyObject *clauses)
+{
+    flatcnf f;
+    Py_ssize_t i;
+    int n = 0, size = 0;
+
+    if (flat_clauses(clauses, &f) < 0)
+        return -1;
+    cp->start = PyMem_Malloc((f.nclauses + 1) * sizeof(int));
+    cp->lits = PyMem_Malloc((f.n - f.nclauses + 1) * sizeof(int));
+    if (cp->start == NULL || cp->lits == NULL) {
+        PyMem_Free(f.lits);
+        PyErr_NoMemory();
+        return -1;
+    }
+    cp->start[0] = 0;
+    for (i = 0; i < f.n; i++) {
+        if (f.lits[i])
+            cp->lits[size++] = f.lits[i];
+        else
+            cp->start[++n] = size;
+    }
+    cp->nclauses = n;
+    PyMem_Free(f.lits);
+    return 0;
+}
+
+static void compiler_free(compiler *cp)
+{
+    if (cp->picosat)
+        picosat_reset(cp->picosat);
+    PyMem_Free(cp->lits);
+    PyMem_Free(cp->start);
+    PyMem_Free(cp->val);
+    PyMem_Free(cp->path);
+    PyMem_Free(cp->trail);
+    PyMem_Free(cp->litnode);
+    PyMem_Free(cp->parent);
+    PyMem_Free(cp->comp);
+    PyMem_Free(cp->cnt);
+    PyMem_Free(cp->table);
+    PyMem_Free(cp->keys);
+}
+
+/* Compile the clauses into a new circuit */
+static circuit* compile_dnnf(PyObject *args, PyObject *kwds)
+{
+    compiler cp;
+    circuit *c;
+    PyObject *clauses;
+    int *vars = NULL, *cls = NULL, *units = NULL, nunits = 0;
+    int nvars, i, res, t;
+
+    memset(&cp, 0, sizeof(compiler));
+    c = PyMem_Malloc(sizeof(circuit));
+    if (c == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memset(c, 0, sizeof(circuit));
+    c->refs = 1;
+    cp.c = c;
+
+    cp.picosat = setup_picosat(args, kwds, NULL, NULL);
+    if (cp.picosat == NULL)
+        goto error;
+    clauses = PyTuple_Size(args) > 0 ? PyTuple_GET_ITEM(args, 0) :
+                                       PyDict_GetItemString(kwds, "clauses");
+    if (compiler_clauses(&cp, clauses) < 0)
+        goto error;
+
+    c->nvars = nvars = picosat_variables(cp.picosat);
+    cp.val = PyMem_Malloc(nvars + 1);
+    cp.path = PyMem_Malloc((nvars + 1) * sizeof(int));
+    cp.trail = PyMem_Malloc((nvars + 1) * sizeof(int));
+    cp.litnode = PyMem_Malloc((2 * nvars + 2) * sizeof(int));
+    cp.parent = PyMem_Malloc((nvars + 1) * sizeof(int));
+    cp.comp = PyMem_Malloc((nvars + 1) * sizeof(int));
+    cp.cnt = PyMem_Malloc((nvars + 1) * sizeof(int));
+    vars = PyMem_Malloc((nvars + 1) * sizeof(int));
+    units = PyMem_Malloc((nvars + 1) * sizeof(int));
+    cls = PyMem_Malloc((cp.nclauses + 1) * sizeof(int));
+    if (!cp.val || !cp.path || !cp.trail || !cp.litnode || !cp.parent ||
+            !cp.comp || !cp.cnt || !vars || !units || !cls) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    memset(cp.val, 0, nvars + 1);
+    cp.path[0] = 0;
+    for (i = 0; i < 2 * nvars + 2; i++)
+        cp.litnode[i] = -1;
+    for (i = 0; i < nvars; i++)
+        vars[i] = i + 1;
+    for (i = 0; i < cp.nclauses; i++)
+        cls[i] = i;
+
+    if (new_node(c, DNNF_FALSE, 0, 0, 0) < 0 ||
+            new_node(c, DNNF_TRUE, 0, 0, 0) < 0)
+        goto error;
+
+    res = check_path(&cp);
+    if (res < 0)
+        goto error;
+    if (res == 0) {
+        c->root = DNNF_FALSE;
+    }
+    else {
+        for (i = 1; i <= nvars; i++)
+            if ((t = picosat_deref_toplevel(cp.picosat, i))) {
+                assign_var(&cp, t * i);
+                units[nunits++] = t * i;
+            }
+        c->root = build_and(&cp, vars, nvars, cls, cp.nclauses,
+                            units, nunits);
+        if (c->root < 0)
+            goto error;
+    }
+    PyMem_Free(vars);
+    PyMem_Free(units);
+    PyMem_Free(cls);
+    compiler_free(&cp);
+    return c;
+
+ error:
+    PyMem_Free(vars);
+    PyMem_Free(units);
+    PyMem_Free(cls);
+    compiler_free(&cp);
+    circuit_release(c);
+    return NULL;
+}
+
+typedef struct {
+    PyObject_HEAD
+    circuit *c;
+    signed char *fixed;         /* values of conditioned variables */
+    int conflict;               /* conditioned on inconsistent literals */
+} dnnfobject;
+
+static PyObject* dnnf_new(PyTypeObject *type, PyObject *args,
+                          PyObject *kwds)
+{
+    dnnfobject *self;
+
+    self = (dnnfobject *) type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+    self->c = compile_dnnf(args, kwds);
+    if (self->c == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    self->fixed = PyMem_Malloc(self->c->nvars + 1);
+    if (self->fixed == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    memset(self->fixed, 0, self->c->nvars + 1);
+    return (PyObject *) self;
+}
+
+static void dnnf_dealloc(dnnfobject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+
+    circuit_release(self->c);
+    PyMem_Free(self->fixed);
+    tp->tp_free((PyObject *) self);
+    RELEASE_TYPE(tp);
+}
+
+/* Return the values of the variables, which are those the circuit is
+   conditioned on, and the literals in 'assumptions' (if not NULL or None).
+   Sets '*conflict' if they are inconsistent. */
+static signed char* dnnf_fixed(dnnfobject *self, PyObject *assumptions,
+                               int *conflict)
+{
+    signed char *fixed;
+    Py_ssize_t n = 0, i;
+    int *lits = NULL, v;
+
+    if (assumptions && assumptions != Py_None) {
+        n = get_lits(assumptions, &lits);
+        if (n < 0)
+            return NULL;
+    }
+    fixed = PyMem_Malloc(self->c->nvars + 1);
+    if (fixed == NULL) {
+        PyMem_Free(lits);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memcpy(fixed, self->fixed, self->c->nvars + 1);
+    *conflict = self->conflict;
+    for (i = 0; i < n; i++) {
+        v = abs(lits[i]);
+        if (v > self->c->nvars) {
+            PyErr_Format(PyExc_ValueError, "invalid variable %d", v);
+            PyMem_Free(fixed);
+            PyMem_Free(lits);
+            return NULL;
+        }
+        if (fixed[v] && fixed[v] != (lits[i] > 0 ? 1 : -1))
+            *conflict = 1;
+        fixed[v] = lits[i] > 0 ? 1 : -1;
+    }
+    PyMem_Free(lits);
+    return fixed;
+}
+
+/* weight of a literal under the fixed values (0 or 1) */
+#define WEIGHT(fixed, lit)  \
+    ((fixed)[abs(lit)] == 0 || (fixed)[abs(lit)] == ((lit) > 0 ? 1 : -1))
+
+static PyObject* power_of_two(int k)
+{
+    PyObject *one, *shift, *res = NULL;
+
+    one = PyInt_FromLong(1L);
+    shift = PyInt_FromLong((long) k);
+    if (one && shift)
+        res = PyNumber_Lshift(one, shift);
+    Py_XDECREF(one);
+    Py_XDECREF(shift);
+    return res;
+}
+
+/* Count the models of every node as Python integers */
+static PyObject** dnnf_counts(circuit *c, const signed char *fixed)
+{
+    PyObject **cnt, *x, *y;
+    dnnfnode *node;
+    int i, j, free;
+
+    cnt = PyMem_Malloc(c->nnodes * sizeof(PyObject *));
+    if (cnt == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (i = 0; i < c->nnodes; i++) {
+        node = c->nodes + i;
+        switch (node->kind) {
+        case DNNF_FALSE:
+        case DNNF_TRUE:
+            x = PyInt_FromLong((long) node->kind);
+            break;
+        case DNNF_LIT:
+            x = PyInt_FromLong((long) WEIGHT(fixed, node->a));
+            break;
+        case DNNF_AND:
+            for (free = 0, j = 0; j < node->c; j++)
+                if (fixed[c->kids[node->a + node->b + j]] == 0)
+                    free++;
+            x = power_of_two(free);
+            for (j = 0; x && j < node->b; j++) {
+                y = PyNumber_Multiply(x, cnt[c->kids[node->a + j]]);
+                Py_DECREF(x);
+                x = y;
+            }
+            break;
+        default:                /* DNNF_DEC */
+            if (WEIGHT(fixed, node->a) && WEIGHT(fixed, -node->a))
+                x = PyNumber_Add(cnt[node->b], cnt[node->c]);
+            else {
+                x = WEIGHT(fixed, node->a) ? cnt[node->b] :
+                    (WEIGHT(fixed, -node->a) ? cnt[node->c] : cnt[DNNF_FALSE]);
+                Py_INCREF(x);
+            }
+        }
+        if (x == NULL) {
+            while (--i >= 0)
+                Py_DECREF(cnt[i]);
+            PyMem_Free(cnt);
+            return NULL;
+        }
+        cnt[i] = x;
+    }
+    return cnt;
+}
+
+static void free_counts(PyObject **cnt, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        Py_DECREF(cnt[i]);
+    PyMem_Free(cnt);
+}
+
+static PyObject* dnnf_count(dnnfobject *self, PyObject *args)
+{
+    PyObject *assumptions = NULL, **cnt, *result;
+    signed char *fixed;
+    int conflict;
+
+    if (!PyArg_ParseTuple(args, "|O:count", &assumptions))
+        return NULL;
+    fixed = dnnf_fixed(self, assumptions, &conflict);
+    if (fixed == NULL)
+        return NULL;
+    if (conflict) {
+        PyMem_Free(fixed);
+        return PyInt_FromLong(0L);
+    }
+    cnt = dnnf_counts(self->c, fixed);
+    PyMem_Free(fixed);
+    if (cnt == NULL)
+        return NULL;
+    result = cnt[self->c->root];
+    Py_INCREF(result);
+    free_counts(cnt, self->c->nnodes);
+    return result;
+}
+
+static PyObject* dnnf_satisfiable(dnnfobject *self, PyObject *args)
+{
+    PyObject *assumptions = NULL;
+    circuit *c = self->c;
+    dnnfnode *node;
+    signed char *fixed, *sat;
+    int conflict, i, j, res;
+
+    if (!PyArg_ParseTuple(args, "|O:satisfiable", &assumptions))
+        return NULL;
+    fixed = dnnf_fixed(self, assumptions, &conflict);
+    if (fixed == NULL)
+        return NULL;
+    sat = PyMem_Malloc(c->nnodes);
+    if (sat == NULL) {
+        PyMem_Free(fixed);
+        return PyErr_NoMemory();
+    }
+    for (i = 0; i < c->nnodes; i++) {
+        node = c->nodes + i;
+        switch (node->kind) {
+        case DNNF_FALSE:
+        case DNNF_TRUE:
+            sat[i] = node->kind;
+            break;
+        case DNNF_LIT:
+            sat[i] = WEIGHT(fixed, node->a);
+            break;
+        case DNNF_AND:
+            for (sat[i] = 1, j = 0; sat[i] && j < node->b; j++)
+                sat[i] = sat[c->kids[node->a + j]];
+            break;
+        default:                /* DNNF_DEC */
+            sat[i] = (WEIGHT(fixed, node->a) && sat[node->b]) ||
+                     (WEIGHT(fixed, -node->a) && sat[node->c]);
+        }
+    }
+    res = !conflict && sat[c->root];
+    PyMem_Free(sat);
+    PyMem_Free(fixed);
+    return PyBool_FromLong((long) res);
+}
+
+static PyObject* dnnf_condition(dnnfobject *self, PyObject *assumptions)
+{
+    dnnfobject *res;
+
+    res = PyObject_New(dnnfobject, Py_TYPE(self));
+    if (res == NULL)
+        return NULL;
+    res->c = self->c;
+    res->c->refs++;
+    res->fixed = NULL;
+    res->fixed = dnnf_fixed(self, assumptions, &res->conflict);
+    if (res->fixed == NULL) {
+        Py_DECREF(res);
+        return NULL;
+    }
+    return (PyObject *) res;
+}
+
+static PyObject* dnnf_size(dnnfobject *self)
+{
+    return PyInt_FromLong((long) self->c->nnodes);
+}
+
+/* Iterator over the models of a circuit, which are obtained from their
+   index by the model counts of all nodes */
+typedef struct {
+    PyObject_HEAD
+    circuit *c;
+    signed char *fixed, *model;
+    PyObject **cnt;
+    PyObject *index;            /* of the next model */
+} dnnfiterobject;
+
+static PyObject* dnnf_itersolve(dnnfobject *self, PyObject *args)
+{
+    PyObject *assumptions = NULL;
+    dnnfiterobject *it;
+    int conflict;
+
+    if (!PyArg_ParseTuple(args, "|O:itersolve", &assumptions))
+        return NULL;
+    it = PyObject_New(dnnfiterobject,
+                      type_state(Py_TYPE(self))->DDNNFIter_Type);
+    if (it == NULL)
+        return NULL;
+    it->c = self->c;
+    it->c->refs++;
+    it->model = NULL;
+    it->cnt = NULL;
+    it->fixed = NULL;
+    it->index = PyInt_FromLong(0L);
+    it->fixed = dnnf_fixed(self, assumptions, &conflict);
+    if (it->index == NULL || it->fixed == NULL)
+        goto error;
+    it->model = PyMem_Malloc(it->c->nvars + 1);
+    if (it->model == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    if (!conflict) {
+        it->cnt = dnnf_counts(it->c, it->fixed);
+        if (it->cnt == NULL)
+            goto error;
+    }
+    return (PyObject *) it;
+
+ error:
+    Py_DECREF(it);
+    return NULL;
+}
+
+static void dnnfiter_dealloc(dnnfiterobject *it)
+{
+    PyTypeObject *tp = Py_TYPE(it);
+
+    circuit_release(it->c);
+    if (it->cnt)
+        free_counts(it->cnt, it->c->nnodes);
+    PyMem_Free(it->fixed);
+    PyMem_Free(it->model);
+    Py_XDECREF(it->index);
+    PyObject_Del(it);
+    RELEASE_TYPE(tp);
+}
+
+/* Set the model to the k-th model of the node (k is borrowed) */
+static int unrank(dnnfiterobject *it, int i, PyObject *k)
+{
+    circuit *c = it->c;
+    dnnfnode *node = c->nodes + i;
+    PyObject *qr, *q, *r;
+    int j, v, cmp, res = 0;
+
+    switch (node->kind) {
+    case DNNF_LIT:
+        it->model[abs(node->a)] = node->a > 0 ? 1 : -1;
+        return 0;
+    case DNNF_AND:
+        Py_INCREF(k);
+        for (j = 0; j < node->b; j++) {
+            qr = PyNumber_Divmod(k, it->cnt[c->kids[node->a + j]]);
+            Py_DECREF(k);
+            if (qr == NULL)
+                return -1;
+            q = PyTuple_GET_ITEM(qr, 0);
+            r = PyTuple_GET_ITEM(qr, 1);
+            res = unrank(it, c->kids[node->a + j], r);
+            k = q;
+            Py_INCREF(k);
+            Py_DECREF(qr);
+            if (res < 0) {
+                Py_DECREF(k);
+                return -1;
+            }
+        }
+        for (j = 0; j < node->c; j++) {
+            v = c->kids[node->a + node->b + j];
+            if (it->fixed[v]) {
+                it->model[v] = it->fixed[v];
+                continue;
+            }
+            qr = PyNumber_Divmod(k, r = PyInt_FromLong(2L));
+            Py_XDECREF(r);
+            Py_DECREF(k);
+            if (qr == NULL)
+                return -1;
+            it->model[v] = PyObject_IsTrue(PyTuple_GET_ITEM(qr, 1)) ? 1 : -1;
+            k = PyTuple_GET_ITEM(qr, 0);
+            Py_INCREF(k);
+            Py_DECREF(qr);
+        }
+        Py_DECREF(k);
+        return 0;
+    case DNNF_DEC:
+        v = node->a;
+        if (WEIGHT(it->fixed, v)) {
+            cmp = PyObject_RichCompareBool(k, it->cnt[node->b], Py_LT);
+            if (cmp < 0)
+                return -1;
+            if (cmp) {
+                it->model[v] = 1;
+                return unrank(it, node->b, k);
+            }
+            k = PyNumber_Subtract(k, it->cnt[node->b]);
+            if (k == NULL)
+                return -1;
+        }
+        else
+            Py_INCREF(k);
+        it->model[v] = -1;
+        res = unrank(it, node->c, k);
+        Py_DECREF(k);
+        return res;
+    }
+    return 0;
+}
+
+/* Return the model (values of the variables 1 to nvars) as list */
+static PyObject* get_model(const signed char *model, int nvars)
+{
+    PyObject *list;
+    int i;
+
+    list = PyList_New((Py_ssize_t) nvars);
+    if (list == NULL)
+        return NULL;
+    for (i = 1; i <= nvars; i++)
+        if (PyList_SetItem(list, (Py_ssize_t) (i - 1),
+                           PyInt_FromLong((long) (model[i] * i))) < 0) {
+            Py_DECREF(list);
+            return NULL;
+        }
+    return list;
+}
+
+static PyObject* dnnfiter_next(dnnfiterobject *it)
+{
+    PyObject *one, *next;
+    int cmp;
+
+    if (it->cnt == NULL)
+        return NULL;            /* no models */
+    cmp = PyObject_RichCompareBool(it->index, it->cnt[it->c->root], Py_LT);
+    if (cmp <= 0)
+        return NULL;
+
+    memset(it->model, 0, it->c->nvars + 1);
+    if (unrank(it, it->c->root, it->index) < 0)
+        return NULL;
+
+    one = PyInt_FromLong(1L);
+    if (one == NULL)
+        return NULL;
+    next = PyNumber_Add(it->index, one);
+    Py_DECREF(one);
+    if (next == NULL)
+        return NULL;
+    Py_DECREF(it->index);
+    it->index = next;
+    return get_model(it->model, it->c->nvars);
+}
+
+static PyMethodDef dnnf_methods[] = {
+    {"count",       (PyCFunction) dnnf_count,       METH_VARARGS},
+    {"satisfiable", (PyCFunction) dnnf_satisfiable, METH_VARARGS},
+    {"condition",   (PyCFunction) dnnf_condition,   METH_O},
+    {"itersolve",   (PyCFunction) dnnf_itersolve,   METH_VARARGS},
+    {"size",        (PyCFunction) dnnf_size,        METH_NOARGS},
+    {NULL,          NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot dnnf_slots[] = {
+    {Py_tp_dealloc, dnnf_dealloc},
+    {Py_tp_methods, dnnf_methods},
+    {Py_tp_new, dnnf_new},
+    {0, NULL}
+};
+
+static PyType_Spec dnnf_spec = {
+    "pycosat.DDNNF", sizeof(dnnfobject), 0,
+    Py_TPFLAGS_DEFAULT, dnnf_slots
+};
+#else
+static PyTypeObject DDNNF_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.DDNNF",                          /* tp_name */
+    sizeof(dnnfobject),                       /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) dnnf_dealloc,                /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    0,                                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    dnnf_methods,                             /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    dnnf_new,                                 /* tp_new */
+};
+#endif
+
+#ifdef HEAP_TYPES
+static PyType_Slot dnnfiter_slots[] = {
+    {Py_tp_dealloc, dnnfiter_dealloc},
+    {Py_tp_iter, PyObject_SelfIter},
+    {Py_tp_iternext, dnnfiter_next},
+    {0, NULL}
+};
+
+static PyType_Spec dnnfiter_spec = {
+    "pycosat.dnnfiterator", sizeof(dnnfiterobject), 0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION, dnnfiter_slots
+};
+#else
+static PyTypeObject DDNNFIter_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.dnnfiterator",                   /* tp_name */
+    sizeof(dnnfiterobject),                   /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) dnnfiter_dealloc,            /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    0,                                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    PyObject_SelfIter,                        /* tp_iter */
+    (iternextfunc) dnnfiter_next,             /* tp_iternext */
+    0,                                        /* tp_methods */
+};
+#endif
+
+/***************************** Solver daemon ****************************/
+
+#ifdef HAVE_SERVE
+/* The daemon keeps base clauses loaded in the solvers of its worker
+   threads, and solves requests of clients over a Unix domain socket.  All
+   integers are in native byte order.  A request is a servehead followed
+   by 'nclauses' literals of additional zero terminated clauses and
+   'nassumptions' assumptions.  The reply is 'int32 res, n' followed by the
+   'n' literals of the solution (only if res is PICOSAT_SATISFIABLE), and
+   res is -1 for an invalid request.  A request with a negative base shuts
+   down the daemon.  Each connection has at most one request in flight.
+   The connections are non-blocking: the dispatcher buffers the partial
+   request and the unsent reply of each connection (the workers only
+   compute replies), so a slow client does not stall others. */
+typedef struct {
+    int32_t base, nclauses, nassumptions, reserved;
+    uint64_t prop_limit;
+} servehead;
+
+#define SERVE_MAXLITS  (1 << 22)    /* default limit of literals of a
+                                       request (max_lits) */
+#define SERVE_MAXVAR   (1 << 24)    /* new variables of a request */
+#define SERVE_BATCH    64           /* requests of one base in a batch */
+
+/* A connection, its partial request and its unsent reply */
+typedef struct {
+    int fd;                     /* -1 when closed */
+    int busy;                   /* request with a worker */
+    servehead head;
+    size_t got;                 /* bytes of the request received */
+    int *lits;                  /* literals received so far */
+    int size;                   /* capacity of 'lits' */
+    int *reply;                 /* reply to be sent (or NULL) */
+    size_t nreply, sent;        /* bytes of the reply, and sent of them */
+} serveconn;
+
+typedef struct servereq {
+    int conn;                   /* index of the connection */
+    servehead head;
+    int *lits;                  /* clauses followed by the assumptions */
+    int *reply;                 /* set by the worker (NULL on failure) */
+    size_t nreply;
+    struct servereq *next;
+} servereq;
+
+/* A base loaded into a solver.  Variables beyond the base are mapped to
+   variables of picosat, since picosat_push uses variables itself. */
+typedef struct {
+    PicoSAT *picosat;
+    int *map, nmap;
+} servebase;
+
+typedef struct {
+    const flatcnf *bases;
+    int nbases;
+    servebase *loaded;          /* one for each base, loaded lazily */
+    servereq *batch;            /* requests of one base (NULL when idle) */
+    int index, stop;
+    int wake;                   /* pipe to the daemon */
+    PyThread_type_lock go;      /* released for a batch or to stop */
+} serveworker;
+
+static int serve_map(servebase *b, int max_idx, int lit)
+{
+    int k = abs(lit) - max_idx - 1, n, *map;
+
+    if (k < 0)
+        return lit;
+    if (k >= b->nmap) {
+        n = k + 1 > 2 * b->nmap ? k + 1 : 2 * b->nmap;
+        map = realloc(b->map, n * sizeof(int));
+        if (map == NULL)
+            return 0;
+        memset(map + b->nmap, 0, (n - b->nmap) * sizeof(int));
+        b->map = map;
+        b->nmap = n;
+    }
+    if (b->map[k] == 0)
+        b->map[k] = picosat_inc_max_var(b->picosat);
+    return lit < 0 ? -b->map[k] : b->map[k];
+}
+
+/* A new reply to an invalid request (or NULL) */
+static int *serve_reject(void)
+{
+    int *reply = malloc(2 * sizeof(int));
+
+    if (reply) {
+        reply[0] = -1;
+        reply[1] = 0;
+    }
+    return reply;
+}
+
+/* Solve the request 'r' and set its reply.  The additional clauses are
+   added in a context, which is popped afterwards. */
+static void serve_solve(serveworker *w, servereq *r)
+{
+    const flatcnf *f = w->bases + r->head.base;
+    servebase *b = w->loaded + r->head.base;
+    int nc = r->head.nclauses, n = nc + r->head.nassumptions;
+    int i, v, maxv = f->max_idx, err = 0, *reply;
+    unsigned long long prop_limit = r->head.prop_limit;
+    const int *p, *end;
+    PicoSAT *picosat;
+
+    if (b->picosat == NULL) {
+        b->picosat = picosat = picosat_init();
+        picosat_adjust(picosat, f->max_idx);
+        for (p = f->lits, end = p + f->n; p < end; p++) {
+            picosat_add_lits(picosat, (int *) p);
+            while (*p)
+                p++;
+        }
+    }
+    picosat = b->picosat;
+
+    for (i = 0; i < n; i++)
+        if (abs(r->lits[i]) > maxv)
+            maxv = abs(r->lits[i]);
+    reply = malloc((maxv + 2) * sizeof(int));
+    for (v = f->max_idx + 1; reply && v <= maxv; v++)
+        err |= serve_map(b, f->max_idx, v) == 0;
+    if (reply == NULL || err) {
+        free(reply);
+        r->reply = serve_reject();
+        r->nreply = 2 * sizeof(int);
+        return;
+    }
+    for (i = 0; i < n; i++)
+        r->lits[i] = serve_map(b, f->max_idx, r->lits[i]);
+
+    if (nc) {
+        picosat_push(picosat);
+        for (i = 0; i < nc; i++)
+            picosat_add(picosat, r->lits[i]);
+    }
+    for (i = nc; i < n; i++)
+        picosat_assume(picosat, r->lits[i]);
+    picosat_set_propagation_limit(picosat, prop_limit ?
+            picosat_propagations(picosat) + prop_limit : ~0ull);
+
+    reply[0] = picosat_sat(picosat, -1);
+    reply[1] = 0;
+    if (reply[0] == PICOSAT_SATISFIABLE) {
+        for (v = 1; v <= maxv; v++)
+            reply[v + 1] = picosat_deref(picosat,
+                                         serve_map(b, f->max_idx, v)) > 0 ?
+                           v : -v;
+        reply[1] = maxv;
+    }
+    if (nc)
+        picosat_pop(picosat);
+    r->reply = reply;
+    r->nreply = (reply[1] + 2) * sizeof(int);
+}
+
+static void serve_thread(void *arg)
+{
+    serveworker *w = (serveworker *) arg;
+    servereq *r;
+    int k;
+
+    for (;;) {
+        PyThread_acquire_lock(w->go, WAIT_LOCK);
+        if (w->stop)
+            break;
+        for (r = w->batch; r; r = r->next)
+            serve_solve(w, r);
+        /* writes of up to PIPE_BUF bytes to a pipe are atomic */
+        while (write(w->wake, &w->index, sizeof(int)) < 0 && errno == EINTR)
+            ;
+    }
+    for (k = 0; k < w->nbases; k++) {
+        if (w->loaded[k].picosat)
+            picosat_reset(w->loaded[k].picosat);
+        free(w->loaded[k].map);
+    }
+    while (write(w->wake, &w->index, sizeof(int)) < 0 && errno == EINTR)
+        ;
+}
+
+static void serve_free(servereq *r)
+{
+    servereq *next;
+
+    for (; r; r = next) {
+        next = r->next;
+        free(r->lits);
+        free(r->reply);
+        free(r);
+    }
+}
+
+static void serve_close(serveconn *c)
+{
+    close(c->fd);
+    free(c->lits);
+    free(c->reply);
+    c->fd = -1;
+    c->lits = NULL;
+    c->reply = NULL;
+}
+
+/* Send what the socket of connection 'c' takes of its reply.  Returns -1
+   if the connection is to be closed. */
+static int serve_write(serveconn *c)
+{
+    ssize_t k;
+
+    while (c->sent < c->nreply) {
+        k = send(c->fd, (char *) c->reply + c->sent, c->nreply - c->sent,
+                 MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (k <= 0)
+            return -1;
+        c->sent += (size_t) k;
+    }
+    free(c->reply);
+    c->reply = NULL;
+    return 0;
+}
+
+/* Start sending the reply 'reply' of 'n' bytes (which connection 'c'
+   takes over) */
+static int serve_reply(serveconn *c, int *reply, size_t n)
+{
+    if (reply == NULL)
+        return -1;
+    c->reply = reply;
+    c->nreply = n;
+    c->sent = 0;
+    return serve_write(c);
+}
+
+/* Read what is available of the request of the connection 'c' (of at most
+   'maxlits' literals).  Returns 1 for a request in '*req', 2 for a partial
+   request, 0 for an invalid request (which has been rejected), -1 if the
+   connection is to be closed, and -2 for a shutdown.  The buffer grows
+   with the received literals, so a client has to send what it claims. */
+static int serve_read(serveconn *c, const flatcnf *bases, int nbases,
+                      int maxlits, servereq **req)
+{
+    const size_t hs = sizeof(servehead);
+    servehead *head = &c->head;
+    servereq *r;
+    char *p;
+    size_t want;
+    ssize_t k;
+    int i, n = 0, lit, valid, *lits;
+
+    for (;;) {
+        if (c->got >= hs) {
+            n = head->nclauses + head->nassumptions;
+            if (c->got == hs + (size_t) n * sizeof(int))
+                break;
+            if (c->got == hs + (size_t) c->size * sizeof(int)) {
+                i = c->size > n / 2 ? n : 2 * c->size;
+                if (i < 1024)
+                    i = n < 1024 ? n : 1024;
+                lits = realloc(c->lits, i * sizeof(int));
+                if (lits == NULL)
+                    return -1;
+                c->lits = lits;
+                c->size = i;
+            }
+            p = (char *) c->lits + (c->got - hs);
+            want = hs + (size_t) c->size * sizeof(int) - c->got;
+        }
+        else {
+            p = (char *) head + c->got;
+            want = hs - c->got;
+        }
+        k = recv(c->fd, p, want, 0);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 2;
+        if (k <= 0)
+            return -1;
+        c->got += (size_t) k;
+        if (c->got == hs) {
+            if (head->base < 0)
+                return -2;
+            if (head->nclauses < 0 || head->nassumptions < 0 ||
+                    head->reserved || head->nclauses > maxlits ||
+                    head->nassumptions > maxlits - head->nclauses)
+                return -1;
+        }
+    }
+
+    /* the request is complete, and the connection takes the next one */
+    r = malloc(sizeof(servereq));
+    if (r == NULL)
+        return -1;
+    r->head = *head;
+    r->lits = c->lits;
+    r->reply = NULL;
+    r->next = NULL;
+    c->lits = NULL;
+    c->size = 0;
+    c->got = 0;
+
+    valid = head->base < nbases &&
+        (head->nclauses == 0 || r->lits[head->nclauses - 1] == 0);
+    for (i = 0; valid && i < n; i++) {
+        lit = r->lits[i];
+        if (lit == INT_MIN || (lit == 0 && i >= head->nclauses) ||
+                abs(lit) - bases[head->base].max_idx > SERVE_MAXVAR)
+            valid = 0;
+    }
+    if (!valid) {
+        serve_free(r);
+        return serve_reply(c, serve_reject(), 2 * sizeof(int));
+    }
+    *req = r;
+    return 1;
+}
+
+static PyObject* serve(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *bases, *seq = NULL;
+    const char *path;
+    flatcnf *fs = NULL;
+    serveworker *workers = NULL, *w;
+    servereq *queue = NULL, **tail = &queue, *r, **pr, *batch, **bt;
+    struct sockaddr_un addr;
+    struct stat st;
+    struct pollfd *fds = NULL, *pfds;
+    serveconn *conns = NULL, *c;
+    int nconns = 0, szconns = 0, maxlits = SERVE_MAXLITS, bound = 0;
+    int threads = 1, nw = 0, nbusy = 0, nb = 0, lsock = -1, wake[2] = {-1, -1};
+    int i, k, n, nfds, res, accepting, stopping = 0, interrupted = 0, err = 0;
+    static char* kwlist[] = {"path", "bases", "threads", "max_lits", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|ii:serve", kwlist,
+                                     &path, &bases, &threads, &maxlits))
+        return NULL;
+
+    if (threads < 1) {
+        PyErr_SetString(PyExc_ValueError, "positive number of threads "
+                        "expected");
+        return NULL;
+    }
+    if (maxlits < 0) {
+        PyErr_SetString(PyExc_ValueError, "non-negative max_lits expected");
+        return NULL;
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        PyErr_SetString(PyExc_ValueError, "socket path too long");
+        return NULL;
+    }
+
+    seq = PySequence_Fast(bases, "sequence of clauses expected");
+    if (seq == NULL)
+        return NULL;
+    n = (int) PySequence_Fast_GET_SIZE(seq);
+    fs = PyMem_Malloc((n ? n : 1) * sizeof(flatcnf));
+    if (fs == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (nb = 0; nb < n; nb++)
+        if (flat_clauses(PySequence_Fast_GET_ITEM(seq, nb), fs + nb) < 0)
+            goto done;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    lsock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lsock < 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto done;
+    }
+    /* a stale socket of a previous daemon is replaced, but not the socket
+       of a running daemon (nor any other file) */
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        k = socket(AF_UNIX, SOCK_STREAM, 0);
+        res = k >= 0 && connect(k, (struct sockaddr *) &addr,
+                                sizeof(addr)) == 0;
+        if (k >= 0)
+            close(k);
+        if (res) {
+            errno = EADDRINUSE;
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+            goto done;
+        }
+        unlink(path);
+    }
+    if (bind(lsock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        goto done;
+    }
+    bound = 1;
+    if (listen(lsock, 64) < 0 || pipe(wake) < 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto done;
+    }
+
+    workers = PyMem_Malloc(threads * sizeof(serveworker));
+    fds = malloc(2 * sizeof(struct pollfd));
+    if (workers == NULL || fds == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (nw = 0; nw < threads; nw++) {
+        w = workers + nw;
+        w->bases = fs;
+        w->nbases = nb;
+        w->batch = NULL;
+        w->index = nw;
+        w->stop = 0;
+        w->wake = wake[1];
+        w->loaded = calloc(nb ? nb : 1, sizeof(servebase));
+        w->go = PyThread_allocate_lock();
+        if (w->loaded && w->go)
+            PyThread_acquire_lock(w->go, WAIT_LOCK);
+        if (w->loaded == NULL || w->go == NULL ||
+            PyThread_start_new_thread(serve_thread, w) == (unsigned long) -1)
+        {
+            if (w->go)
+                PyThread_free_lock(w->go);
+            free(w->loaded);
+            PyErr_SetString(PyExc_RuntimeError, "can not start thread");
+            goto done;
+        }
+    }
+
+#define SERVE_POLLED(c)  \
+    ((c)->fd >= 0 && !(c)->busy && ((c)->reply || accepting))
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    while (!stopping || nbusy || queue) {
+        /* the listening socket, the pipe of the workers, and the
+           connections without a request at a worker: for a reply to be
+           sent, or (unless stopping) for a request to be read */
+        pfds = realloc(fds, (szconns + 2) * sizeof(struct pollfd));
+        if (pfds == NULL) {
+            err = ENOMEM;
+            stopping = 1;
+            continue;
+        }
+        fds = pfds;
+        accepting = !stopping;
+        fds[0].fd = accepting ? lsock : -1;
+        fds[1].fd = wake[0];
+        fds[0].events = fds[1].events = POLLIN;
+        for (nfds = 2, k = 0; k < nconns; k++) {
+            c = conns + k;
+            if (SERVE_POLLED(c)) {
+                fds[nfds].fd = c->fd;
+                fds[nfds++].events = c->reply ? POLLOUT : POLLIN;
+            }
+        }
+        n = poll(fds, nfds, 100);
+        if (n <= 0) {
+            if (n < 0 && errno != EINTR) {
+                err = errno;
+                stopping = 1;
+            }
+            Py_BLOCK_THREADS
+            interrupted |= PyErr_CheckSignals() < 0;
+            Py_UNBLOCK_THREADS
+            if (interrupted && !stopping) {
+                stopping = 1;
+                serve_free(queue);
+                queue = NULL;
+                tail = &queue;
+            }
+            continue;
+        }
+
+        /* the connections in the same order as above */
+        for (i = 2, k = 0; k < nconns; k++) {
+            c = conns + k;
+            if (!SERVE_POLLED(c) || fds[i++].revents == 0)
+                continue;
+            if (c->reply)
+                res = serve_write(c);
+            else
+                res = serve_read(c, fs, nb, maxlits, &r);
+            if (res == 1) {
+                r->conn = k;
+                c->busy = 1;
+                *tail = r;
+                tail = &r->next;
+            }
+            else if (res == -1) {
+                serve_close(c);
+            }
+            else if (res == -2) {
+                stopping = 1;
+            }
+        }
+        if (fds[1].revents) {       /* finished batches */
+            if (read(wake[0], &k, sizeof(int)) == sizeof(int)) {
+                for (r = workers[k].batch; r; r = r->next) {
+                    c = conns + r->conn;
+                    c->busy = 0;
+                    if (serve_reply(c, r->reply, r->nreply) < 0)
+                        serve_close(c);
+                    r->reply = NULL;
+                }
+                serve_free(workers[k].batch);
+                workers[k].batch = NULL;
+                nbusy--;
+            }
+        }
+        if (fds[0].revents) {       /* new connection */
+            n = accept(lsock, NULL, NULL);
+            if (n >= 0 && fcntl(n, F_SETFL,
+                                fcntl(n, F_GETFL) | O_NONBLOCK) < 0) {
+                close(n);
+                n = -1;
+            }
+            for (k = 0; n >= 0 && k < nconns && conns[k].fd >= 0; k++)
+                ;
+            if (n >= 0 && k == szconns) {
+                c = realloc(conns, (2 * szconns + 16) * sizeof(serveconn));
+                if (c) {
+                    conns = c;
+                    szconns = 2 * szconns + 16;
+                }
+                else {
+                    close(n);
+                    n = -1;
+                }
+            }
+            if (n >= 0) {
+                memset(conns + k, 0, sizeof(serveconn));
+                conns[k].fd = n;
+                if (k == nconns)
+                    nconns++;
+            }
+        }
+
+        /* batches of queued requests of the same base for idle workers */
+        for (k = 0; k < nw && queue; k++) {
+            if (workers[k].batch)
+                continue;
+            batch = NULL;
+            bt = &batch;
+            n = queue->head.base;
+            for (i = 0, pr = &queue; *pr && i < SERVE_BATCH; ) {
+                r = *pr;
+                if (r->head.base == n) {
+                    *pr = r->next;
+                    r->next = NULL;
+                    *bt = r;
+                    bt = &r->next;
+                    i++;
+                }
+                else
+                    pr = &r->next;
+            }
+            for (tail = &queue; *tail; tail = &(*tail)->next)
+                ;
+            workers[k].batch = batch;
+            nbusy++;
+            PyThread_release_lock(workers[k].go);
+        }
+    }
+    Py_END_ALLOW_THREADS
+#undef SERVE_POLLED
+
+    if (err) {
+        errno = err;
+        PyErr_SetFromErrno(PyExc_OSError);
+    }
+
+ done:
+    Py_BEGIN_ALLOW_THREADS
+    for (k = 0; k < nw; k++) {
+        workers[k].stop = 1;
+        PyThread_release_lock(workers[k].go);
+    }
+    for (k = 0; k < nw; k++) {
+        while (read(wake[0], &i, sizeof(int)) < 0 && errno == EINTR)
+            ;
+    }
+    Py_END_ALLOW_THREADS
+    for (k = 0; k < nw; k++) {
+        PyThread_free_lock(workers[k].go);
+        free(workers[k].loaded);
+    }
+    serve_free(queue);
+    for (k = 0; k < nconns; k++)
+        if (conns[k].fd >= 0)
+            serve_close(conns + k);
+    if (lsock >= 0)
+        close(lsock);
+    if (bound)
+        unlink(path);
+    if (wake[0] >= 0) {
+        close(wake[0]);
+        close(wake[1]);
+    }
+    for (k = 0; k < nb; k++)
+        PyMem_Free(fs[k].lits);
+    if (fs)
+        PyMem_Free(fs);
+    if (workers)
+        PyMem_Free(workers);
+    free(fds);
+    free(conns);
+    Py_XDECREF(seq);
+    if (PyErr_Occurred())
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* The client of the daemon */
+typedef struct {
+    PyObject_HEAD
+    int fd;                     /* connection (-1 when closed) */
+} clientobject;
+
+static PyObject* client_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds)
+{
+    clientobject *self;
+    struct sockaddr_un addr;
+    const char *path;
+    int fd, res;
+    static char* kwlist[] = {"path", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:Client", kwlist, &path))
+        return NULL;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        PyErr_SetString(PyExc_ValueError, "socket path too long");
+        return NULL;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return PyErr_SetFromErrno(PyExc_OSError);
+    Py_BEGIN_ALLOW_THREADS
+    res = connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+    Py_END_ALLOW_THREADS
+    if (res < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        close(fd);
+        return NULL;
+    }
+
+    self = (clientobject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        close(fd);
+        return NULL;
+    }
+    self->fd = fd;
+    return (PyObject *) self;
+}
+
+static int client_check(clientobject *self)
+{
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "client is closed");
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* client_solve(clientobject *self, PyObject *args,
+                              PyObject *kwds)
+{
+    PyObject *clauses = NULL, *assumptions = NULL, *result = NULL;
+    unsigned long long prop_limit = 0;
+    servehead head;
+    flatcnf f;
+    Py_ssize_t na = 0, i;
+    int base = 0, *lits = NULL, *buf = NULL, reply[2], res = 0;
+    static char* kwlist[] = {"base", "clauses", "assumptions", "prop_limit",
+                             NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iOOK:solve", kwlist,
+                                     &base, &clauses, &assumptions,
+                                     &prop_limit))
+        return NULL;
+
+    if (client_check(self) < 0)
+        return NULL;
+    if (base < 0) {
+        PyErr_SetString(PyExc_ValueError, "non-negative base expected");
+        return NULL;
+    }
+    f.lits = NULL;
+    f.n = 0;
+    if (clauses && clauses != Py_None && flat_clauses(clauses, &f) < 0)
+        return NULL;
+    if (assumptions && assumptions != Py_None) {
+        na = get_lits(assumptions, &lits);
+        if (na < 0)
+            goto done;
+    }
+    /* the limit of the daemon (max_lits) closes the connection */
+    if (f.n + na > INT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "request too large");
+        goto done;
+    }
+    buf = PyMem_Malloc((f.n + na + 1) * sizeof(int));
+    if (buf == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    if (f.n)
+        memcpy(buf, f.lits, f.n * sizeof(int));
+    for (i = 0; i < na; i++)
+        buf[f.n + i] = lits[i];
+
+    head.base = base;
+    head.nclauses = (int32_t) f.n;
+    head.nassumptions = (int32_t) na;
+    head.reserved = 0;
+    head.prop_limit = prop_limit;
+
+    Py_BEGIN_ALLOW_THREADS
+    if (sock_send(self->fd, &head, sizeof(head)) < 0 ||
+            sock_send(self->fd, buf, (f.n + na) * sizeof(int)) < 0 ||
+            sock_recv(self->fd, reply, sizeof(reply)) < 0)
+        res = -1;
+    Py_END_ALLOW_THREADS
+
+    if (res == 0 && reply[1] > 0) {
+        PyMem_Free(buf);
+        buf = PyMem_Malloc(reply[1] * sizeof(int));
+        if (buf == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        res = sock_recv(self->fd, buf, reply[1] * sizeof(int));
+        Py_END_ALLOW_THREADS
+    }
+    if (res < 0) {
+        PyErr_SetString(PyExc_OSError, "connection to daemon failed");
+        goto done;
+    }
+    switch (reply[0]) {
+    case PICOSAT_SATISFIABLE:
+        result = PyList_New(reply[1]);
+        for (i = 0; result && i < reply[1]; i++)
+            PyList_SET_ITEM(result, i, PyInt_FromLong(buf[i]));
+        break;
+
+    case PICOSAT_UNSATISFIABLE:
+        result = PyUnicode_FromString("UNSAT");
+        break;
+
+    case PICOSAT_UNKNOWN:
+        result = PyUnicode_FromString("UNKNOWN");
+        break;
+
+    default:
+        PyErr_SetString(PyExc_ValueError, "invalid request");
+    }
+
+ done:
+    if (f.lits)
+        PyMem_Free(f.lits);
+    if (lits)
+        PyMem_Free(lits);
+    if (buf)
+        PyMem_Free(buf);
+    return result;
+}
+
+static PyObject* client_shutdown(clientobject *self)
+{
+    servehead head;
+    int res;
+
+    if (client_check(self) < 0)
+        return NULL;
+
+    memset(&head, 0, sizeof(head));
+    head.base = -1;
+    Py_BEGIN_ALLOW_THREADS
+    res = sock_send(self->fd, &head, sizeof(head));
+    Py_END_ALLOW_THREADS
+    if (res < 0)
+        return PyErr_SetFromErrno(PyExc_OSError);
+    Py_RETURN_NONE;
+}
+
+static PyObject* client_close(clientobject *self)
+{
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    Py_RETURN_NONE;
+}
+
+static void client_dealloc(clientobject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+
+    if (self->fd >= 0)
+        close(self->fd);
+    tp->tp_free((PyObject *) self);
+    RELEASE_TYPE(tp);
+}
+
+static PyMethodDef client_methods[] = {
+    {"solve",    (PyCFunction) client_solve,    METH_VARARGS | METH_KEYWORDS},
+    {"shutdown", (PyCFunction) client_shutdown, METH_NOARGS},
+    {"close",    (PyCFunction) client_close,    METH_NOARGS},
+    {NULL,       NULL}  /* sentinel */
+};
+
+#ifdef HEAP_TYPES
+static PyType_Slot client_slots[] = {
+    {Py_tp_dealloc, client_dealloc},
+    {Py_tp_methods, client_methods},
+    {Py_tp_new, client_new},
+    {0, NULL}
+};
+
+static PyType_Spec client_spec = {
+    "pycosat.Client", sizeof(clientobject), 0, Py_TPFLAGS_DEFAULT,
+    client_slots
+};
+#else
+static PyTypeObject Client_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.Client",                         /* tp_name */
+    sizeof(clientobject),                     /* tp_basicsize */
+    0,                                        /* tp_itemsize */
     /* methods */
-    (destructor) soliter_dealloc,             /* tp_dealloc */
+    (destructor) client_dealloc,              /* tp_dealloc */
     0,                                        /* tp_print */
     0,                                        /* tp_getattr */
     0,                                        /* tp_setattr */
@@ -319,16 +6942,28 @@ static PyTypeObject SolIter_Type = {
     PyObject_GenericGetAttr,                  /* tp_getattro */
     0,                                        /* tp_setattro */
     0,                                        /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
     0,                                        /* tp_doc */
-    (traverseproc) soliter_traverse,          /* tp_traverse */
+    0,                                        /* tp_traverse */
     0,                                        /* tp_clear */
     0,                                        /* tp_richcompare */
     0,                                        /* tp_weaklistoffset */
-    PyObject_SelfIter,                        /* tp_iter */
-    (iternextfunc) soliter_next,              /* tp_iternext */
-    0,                                        /* tp_methods */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    client_methods,                           /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    client_new,                               /* tp_new */
 };
+#endif
+#endif  /* HAVE_SERVE */
 
 /*************************** Method definitions *************************/
 
@@ -336,9 +6971,115 @@ static PyTypeObject SolIter_Type = {
 static PyMethodDef module_functions[] = {
     {"solve",     (PyCFunction) solve,     METH_VARARGS | METH_KEYWORDS},
     {"itersolve", (PyCFunction) itersolve, METH_VARARGS | METH_KEYWORDS},
+    {"evaluate",  (PyCFunction) evaluate,  METH_VARARGS},
+    {"sample",    (PyCFunction) sample,    METH_VARARGS | METH_KEYWORDS},
+    {"approx_count", (PyCFunction) approx_count,
+                                           METH_VARARGS | METH_KEYWORDS},
+#ifdef HAVE_SERVE
+    {"serve",     (PyCFunction) serve,     METH_VARARGS | METH_KEYWORDS},
+#endif
     {NULL,        NULL}  /* sentinel */
 };
 
+#ifdef HEAP_TYPES
+/* Create the type of 'spec' for the module 'm'.  It is added to the
+   module if 'public' is true, and stored in '*type' (a new reference) if
+   'type' is not NULL. */
+static int new_type(PyObject *m, PyType_Spec *spec, PyTypeObject **type,
+                    int public)
+{
+    PyObject *t;
+
+    t = PyType_FromModuleAndSpec(m, spec, NULL);
+    if (t == NULL)
+        return -1;
+    if (public && PyModule_AddType(m, (PyTypeObject *) t) < 0) {
+        Py_DECREF(t);
+        return -1;
+    }
+    if (type)
+        *type = (PyTypeObject *) t;
+    else
+        Py_DECREF(t);
+    return 0;
+}
+
+/* execution of the module, which happens once for each (sub)interpreter */
+static int pycosat_exec(PyObject *m)
+{
+    modulestate *st = module_state(m);
+
+    if (new_type(m, &clausebuf_spec, NULL, 1) < 0 ||
+            new_type(m, &cnf_spec, NULL, 1) < 0 ||
+            new_type(m, &cache_spec, NULL, 1) < 0 ||
+            new_type(m, &varmap_spec, &st->VarMap_Type, 1) < 0 ||
+            new_type(m, &solver_spec, NULL, 1) < 0 ||
+            new_type(m, &group_spec, &st->ClauseGroup_Type, 0) < 0 ||
+            new_type(m, &soliter_spec, &st->SolIter_Type, 0) < 0 ||
+            new_type(m, &dnnf_spec, NULL, 1) < 0 ||
+            new_type(m, &dnnfiter_spec, &st->DDNNFIter_Type, 0) < 0)
+        return -1;
+#ifdef HAVE_SERVE
+    if (new_type(m, &client_spec, NULL, 1) < 0)
+        return -1;
+#endif
+
+#ifdef PYCOSAT_VERSION
+    if (PyModule_AddStringConstant(m, "__version__", PYCOSAT_VERSION) < 0)
+        return -1;
+#endif
+    return 0;
+}
+
+static int pycosat_traverse(PyObject *m, visitproc visit, void *arg)
+{
+    modulestate *st = module_state(m);
+
+    Py_VISIT(st->SolIter_Type);
+    Py_VISIT(st->VarMap_Type);
+    Py_VISIT(st->ClauseGroup_Type);
+    Py_VISIT(st->DDNNFIter_Type);
+    return 0;
+}
+
+static int pycosat_clear(PyObject *m)
+{
+    modulestate *st = module_state(m);
+
+    Py_CLEAR(st->SolIter_Type);
+    Py_CLEAR(st->VarMap_Type);
+    Py_CLEAR(st->ClauseGroup_Type);
+    Py_CLEAR(st->DDNNFIter_Type);
+    return 0;
+}
+
+static void pycosat_free(void *m)
+{
+    pycosat_clear((PyObject *) m);
+}
+
+static PyModuleDef_Slot module_slots[] = {
+    {Py_mod_exec, pycosat_exec},
+#ifdef Py_mod_multiple_interpreters
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+    {0, NULL}
+};
+
+static PyModuleDef moduledef = {
+    PyModuleDef_HEAD_INIT, "pycosat", 0, sizeof(modulestate),
+    module_functions, module_slots, pycosat_traverse, pycosat_clear,
+    pycosat_free,
+};
+
+/* initialization routine for the shared libary */
+PyMODINIT_FUNC PyInit_pycosat(void)
+{
+    return PyModuleDef_Init(&moduledef);
+}
+
+#else   /* HEAP_TYPES */
+
 /* initialization routine for the shared libary */
 #ifdef IS_PY3K
 static PyModuleDef moduledef = {
@@ -361,6 +7102,39 @@ PyMODINIT_FUNC initpycosat(void)
         return;
 #endif
 
+    if (PyType_Ready(&ClauseBuffer_Type) < 0 ||
+            PyType_Ready(&CNF_Type) < 0 ||
+            PyType_Ready(&Cache_Type) < 0 ||
+            PyType_Ready(&SolIter_Type) < 0 ||
+            PyType_Ready(&VarMap_Type) < 0 ||
+            PyType_Ready(&Solver_Type) < 0 ||
+            PyType_Ready(&ClauseGroup_Type) < 0 ||
+            PyType_Ready(&DDNNF_Type) < 0 ||
+            PyType_Ready(&DDNNFIter_Type) < 0)
+        goto error;
+    static_state.SolIter_Type = &SolIter_Type;
+    static_state.VarMap_Type = &VarMap_Type;
+    static_state.ClauseGroup_Type = &ClauseGroup_Type;
+    static_state.DDNNFIter_Type = &DDNNFIter_Type;
+    Py_INCREF(&ClauseBuffer_Type);
+    PyModule_AddObject(m, "ClauseBuffer", (PyObject *) &ClauseBuffer_Type);
+    Py_INCREF(&CNF_Type);
+    PyModule_AddObject(m, "CNF", (PyObject *) &CNF_Type);
+    Py_INCREF(&Cache_Type);
+    PyModule_AddObject(m, "Cache", (PyObject *) &Cache_Type);
+    Py_INCREF(&VarMap_Type);
+    PyModule_AddObject(m, "VarMap", (PyObject *) &VarMap_Type);
+    Py_INCREF(&Solver_Type);
+    PyModule_AddObject(m, "Solver", (PyObject *) &Solver_Type);
+    Py_INCREF(&DDNNF_Type);
+    PyModule_AddObject(m, "DDNNF", (PyObject *) &DDNNF_Type);
+#ifdef HAVE_SERVE
+    if (PyType_Ready(&Client_Type) < 0)
+        goto error;
+    Py_INCREF(&Client_Type);
+    PyModule_AddObject(m, "Client", (PyObject *) &Client_Type);
+#endif
+
 #ifdef PYCOSAT_VERSION
     PyModule_AddObject(m, "__version__",
                        PyUnicode_FromString(PYCOSAT_VERSION));
@@ -368,5 +7142,14 @@ PyMODINIT_FUNC initpycosat(void)
 
 #ifdef IS_PY3K
     return m;
+
+ error:
+    Py_DECREF(m);
+    return NULL;
+#else
+ error:
+    return;
 #endif
 }
+
+#endif  /* HEAP_TYPES */
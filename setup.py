@@ -36,6 +36,7 @@ setup(
     ],
     ext_modules = [Extension(**ext_kwds)],
     py_modules = ['test_pycosat'],
+    scripts = ['pycosat-serve'],
     description = "bindings to picosat",
     long_description = open('README.rst').read(),
 )
@@ -1,8 +1,13 @@
 import sys
 import copy
+import os
+import time
 import random
+import tempfile
+import threading
 from os.path import basename
 import unittest
+from array import array
 
 import pycosat
 from pycosat import solve, itersolve
@@ -124,6 +129,75 @@ class TestSolve(unittest.TestCase):
         self.assertEqual(solve(clauses1, vars=7),
                          [1, -2, -3, -4, 5, -6, -7])
 
+    def test_cnf1_phases(self):
+        # starting from a solution, the solver should return it right away
+        for sol in itersolve(clauses1, nvars1):
+            self.assertEqual(solve(clauses1, phases=sol), sol)
+            self.assertEqual(solve(clauses1, phases=array('i', sol)), sol)
+
+    def test_phases_new_vars(self):
+        # literals of variables not in the clauses do not add variables
+        self.assertEqual(len(solve([[1, 2]], vars=2, phases=[1, 3])), 2)
+        self.assertEqual(solve([[1, 2]], phases=[-1, 100000]), [-1, 2])
+        self.assertEqual(solve([[1, 2]], phases=[-2147483647]), [1, 2])
+
+    def test_wrong_phases(self):
+        self.assertRaises(TypeError, solve, clauses1, phases={})
+        self.assertRaises(TypeError, solve, clauses1, phases=['a'])
+        self.assertRaises(TypeError, solve, clauses1, phases=array('d', [1]))
+        self.assertRaises(ValueError, solve, clauses1, phases=[1, 0])
+
+    def test_priorities(self):
+        # exactly one of 1 and 2, where the variable decided first is
+        # assigned to false
+        cnf = [[1, 2], [-1, -2]]
+        self.assertEqual(solve(cnf, priorities={1: 1}), [-1, 2])
+        self.assertEqual(solve(cnf, priorities={2: 1}), [1, -2])
+        self.assertEqual(solve(cnf, priorities={1: -5, 2: -1}), [1, -2])
+        self.assertEqual(len(list(itersolve(clauses1,
+                                            priorities={3: 2, 4: 1}))), 18)
+        # random decisions are taken from the highest priority only
+        cnf = [[1, 2], [-1, -2]] + [[i, i + 1] for i in range(3, 40)]
+        for v in range(1, 3):
+            sol = solve(cnf, priorities={v: 1}, rdecide=1)
+            self.assertEqual(sol[v - 1], -v)
+
+    def test_priorities_new_vars(self):
+        # variables not in the clauses do not add variables
+        self.assertEqual(len(solve([[1, 2]], priorities={5: 1})), 2)
+        self.assertEqual(solve([[1, 2], [-1, -2]], priorities={1: 1, -9: 3}),
+                         [-1, 2])
+
+    def test_wrong_priorities(self):
+        self.assertRaises(TypeError, solve, clauses1, priorities=[1])
+        self.assertRaises(TypeError, solve, clauses1, priorities={1: 'a'})
+        self.assertRaises(ValueError, solve, clauses1, priorities={0: 1})
+
+    def test_options(self):
+        for opts in [dict(probe=0), dict(dsc=0), dict(luby=0),
+                     dict(rdecide=0), dict(reusetrail=0, glue=0), dict(simd=0),
+                     dict(dsc=0, simd=0, stats=0),
+                     dict(luby=0, minrestart=1, frestart=200)]:
+            self.assertEqual(solve(clauses2, **opts), "UNSAT")
+            self.assertEqual(len(list(itersolve(clauses1, **opts))), 18)
+
+    def test_long_clauses(self):
+        # exactly one of 40 variables, and a long clause of negative
+        # literals, such that the search in long clauses is exercised
+        cnf = [list(range(1, 41)), [-i for i in range(1, 41, 3)]]
+        cnf.extend([-i, -j] for i in range(1, 41) for j in range(i + 1, 41))
+        for opts in {}, dict(simd=0):
+            sols = list(itersolve(cnf, **opts))
+            self.assertEqual(len(sols), 40)
+            for sol in sols:
+                self.assertTrue(evaluate(cnf, sol))
+
+    def test_wrong_options(self):
+        self.assertRaises(TypeError, solve, clauses1, nosuchoption=1)
+        self.assertRaises(TypeError, solve, clauses1, probe='a')
+        self.assertRaises(ValueError, solve, clauses1, probe=2)
+        self.assertRaises(ValueError, solve, clauses1, reduce=0)
+
 tests.append(TestSolve)
 
 # -----
@@ -167,6 +241,16 @@ class TestIterSolve(unittest.TestCase):
         self.assertEqual(set(tuple(sol) for sol in itersolve(cnf)),
                          ref_sols)
 
+    def test_no_blocking(self):
+        for n in range(1, 8):
+            sols = list(itersolve([], vars=n, blocking=False))
+            self.assertEqual(len(set(tuple(sol) for sol in sols)), 2 ** n)
+        sols = list(itersolve(clauses1, blocking=False))
+        self.assertEqual(len(sols), 18)
+        self.assertEqual(set(tuple(sol) for sol in sols),
+                         set(tuple(sol) for sol in itersolve(clauses1)))
+        self.assertEqual(list(itersolve(clauses2, blocking=False)), [])
+
     def test_cnf2(self):
         self.assertEqual(list(itersolve(clauses2, nvars2)), [])
 
@@ -179,6 +263,683 @@ class TestIterSolve(unittest.TestCase):
 
 tests.append(TestIterSolve)
 
+# -----
+
+class TestSolver(unittest.TestCase):
+
+    def test_incremental(self):
+        s = pycosat.Solver()
+        self.assertEqual(s.solve(), [])
+        s.add_clauses(clauses1)
+        self.assertTrue(evaluate(clauses1, s.solve()))
+        self.assertEqual(s.solve(assumptions=[3, 4]), "UNSAT")
+        self.assertEqual(s.solve([-1, 3])[:3], [-1, -2, 3])
+        s.add_clause(array('i', [-1]))
+        s.add_clause([5])
+        sol = s.solve()
+        self.assertEqual(sol[2:], [-3, 4, 5])
+        s.add_clause([-4])
+        self.assertEqual(s.solve(), "UNSAT")
+
+    def test_clauses_vars(self):
+        s = pycosat.Solver(clauses3, vars=3)
+        self.assertEqual(s.solve(), [-1, -2, -3])
+
+    def test_prop_limit(self):
+        s = pycosat.Solver(clauses1)
+        self.assertEqual(s.solve(prop_limit=2), "UNKNOWN")
+        self.assertTrue(evaluate(clauses1, s.solve()))
+        s = pycosat.Solver(clauses1, prop_limit=2)
+        self.assertEqual(s.solve(), "UNKNOWN")
+        self.assertEqual(s.solve(), "UNKNOWN")
+        self.assertTrue(evaluate(clauses1, s.solve(prop_limit=0)))
+
+    def test_options(self):
+        s = pycosat.Solver(clauses1, probe=0)
+        self.assertEqual(s.get_option('probe'), 0)
+        s.set_option('luby', 1)
+        self.assertEqual(s.get_option('luby'), 1)
+        s.set_option('luby', 0)
+        self.assertEqual(s.get_option('luby'), 0)
+        self.assertTrue(evaluate(clauses1, s.solve()))
+        self.assertRaises(ValueError, s.get_option, 'nosuchoption')
+        self.assertRaises(ValueError, s.set_option, 'nosuchoption', 1)
+
+    def test_restart_options(self):
+        # pigeon hole: 8 pigeons in 7 holes
+        v = lambda p, h: 7 * p + h + 1
+        cnf = [[v(p, h) for h in range(7)] for p in range(8)]
+        cnf.extend([-v(p, h), -v(q, h)] for h in range(7)
+                   for p in range(8) for q in range(p + 1, 8))
+        # a minimal restart interval above the maximal one
+        s = pycosat.Solver(cnf)
+        s.set_option('luby', 0)
+        s.set_option('maxrestart', 100)
+        s.set_option('minrestart', 1000)
+        self.assertEqual(s.solve(), "UNSAT")
+        self.assertRaises(ValueError, s.set_option, 'luby', 2)
+        self.assertRaises(TypeError, s.set_option, 'luby', None)
+
+    def test_wrong_args(self):
+        self.assertRaises(TypeError, pycosat.Solver, {})
+        self.assertRaises(TypeError, pycosat.Solver, clauses1, nosuch=1)
+        s = pycosat.Solver()
+        self.assertRaises(TypeError, s.add_clause, 1)
+        self.assertRaises(ValueError, s.add_clause, [1, 0])
+        self.assertRaises(TypeError, s.add_clauses, [[1], 'a'])
+        self.assertEqual(s.solve(), [1])
+
+    def test_groups(self):
+        s = pycosat.Solver(clauses1)
+        g1 = s.add_group()
+        g1.add_clause([-1])
+        g2 = s.add_group()
+        g2.add_clauses([[5], [-4]])
+        self.assertEqual(s.solve(), "UNSAT")
+        g1.disable()
+        sol = s.solve()
+        self.assertEqual((sol[0], sol[3], sol[4]), (1, -4, 5))
+        g1.enable()
+        g2.delete()
+        sol = s.solve()
+        self.assertEqual(len(sol), 5)
+        self.assertEqual(sol[0], -1)
+        self.assertTrue(evaluate(clauses1, sol))
+        self.assertRaises(ValueError, g2.add_clause, [1])
+        self.assertRaises(ValueError, g2.enable)
+        g1.delete()
+        self.assertEqual(len(list(itersolve(clauses1))), 18)
+        # groups are deleted in any order, and internal variables recycled
+        for _ in range(30):
+            g = [s.add_group() for _ in range(3)]
+            g[0].add_clause([-1])
+            g[1].add_clause([1])
+            g[2].add_clause([2])
+            self.assertEqual(s.solve(), "UNSAT")
+            g[0].delete()
+            self.assertEqual(s.solve()[:2], [1, 2])
+            g[2].delete()
+            g[1].delete()
+        self.assertTrue(evaluate(clauses1, s.solve(assumptions=[-2])))
+
+    def test_groups_new_vars(self):
+        s = pycosat.Solver(clauses1, vars=6)
+        g = s.add_group()
+        g.add_clause([6])
+        self.assertEqual(s.solve()[5], 6)
+        self.assertRaises(ValueError, g.add_clause, [7])
+        self.assertRaises(ValueError, s.add_clause, [-7])
+        self.assertRaises(ValueError, s.solve, [7])
+        g.delete()
+        self.assertEqual(len(s.solve()), 6)
+
+    def test_propagate(self):
+        s = pycosat.Solver(clauses1)
+        self.assertEqual(s.propagate(), (True, []))
+        self.assertEqual(s.propagate([-1, 5]), (True, [4, -3]))
+        self.assertEqual(s.propagate([3, 4]), (False, [4]))
+        self.assertEqual(s.propagate([3, -4]), (True, [-4]))
+        g = s.add_group()
+        g.add_clause([-4])
+        self.assertEqual(s.propagate([-1, 5]), (False, [5]))
+        self.assertEqual(s.propagate([5, -1]), (False, [-1]))
+        g.disable()
+        self.assertEqual(s.propagate(array('i', [5, -1])), (True, [4, -3]))
+        self.assertTrue(evaluate(clauses1, s.solve([5, -1])))
+        s = pycosat.Solver(clauses3)
+        res, conflict = s.propagate([1])
+        self.assertFalse(res)
+        self.assertTrue(-1 in conflict and len(conflict) == 2)
+        self.assertEqual(s.propagate([-1]), (True, [-2]))
+        s.add_clause([1])
+        self.assertEqual(s.propagate(), (False, []))
+        self.assertEqual(s.solve(), "UNSAT")
+
+    def test_batch(self):
+        s = pycosat.Solver(clauses1)
+        queries = [[3, 4], [1], [-1, -5, 3], [1, -5], [-1, 5, -4], []]
+        for threads in 1, 2, 4, 8:
+            self.assertEqual(s.solve_assumptions_batch(queries,
+                                                       threads=threads),
+                             ["UNSAT", "SAT", "SAT", "SAT", "UNSAT", "SAT"])
+            res = s.solve_assumptions_batch(queries, threads=threads,
+                                            models=True, failed=True)
+            self.assertEqual(sorted(res[0]), [3, 4])
+            self.assertEqual(sorted(res[4]), [-4, -1, 5])
+            for q, sol in zip(queries, res):
+                if q != [3, 4] and q != [-1, 5, -4]:
+                    self.assertTrue(evaluate(clauses1, sol))
+                    self.assertTrue(set(q) <= set(sol))
+        self.assertEqual(s.solve_assumptions_batch([]), [])
+
+    def test_batch_groups(self):
+        s = pycosat.Solver(clauses1)
+        g = s.add_group()
+        g.add_clause([-1])
+        self.assertEqual(s.solve_assumptions_batch([[1], [-1]], threads=2,
+                                                   failed=True),
+                         [[1], "SAT"])
+        g.disable()
+        self.assertEqual(s.solve_assumptions_batch([[1], [-1]], threads=2),
+                         ["SAT", "SAT"])
+        self.assertRaises(ValueError, s.solve_assumptions_batch, [[1]],
+                          threads=0)
+        self.assertRaises(ValueError, s.solve_assumptions_batch, [[9]])
+        self.assertRaises(TypeError, s.solve_assumptions_batch, 1)
+
+    def test_cubes(self):
+        if not hasattr(pycosat.Solver, 'solve_cubes'):
+            return
+        s = pycosat.Solver(clauses1)
+        for processes in 1, 2, 5:
+            for depth in 0, 1, 3:
+                sol = s.solve_cubes(processes=processes, depth=depth)
+                self.assertTrue(evaluate(clauses1, sol))
+        g = s.add_group()
+        g.add_clauses([[1], [-1]])
+        self.assertEqual(s.solve_cubes(processes=2), "UNSAT")
+        g.disable()
+        self.assertTrue(evaluate(clauses1, s.solve_cubes(processes=2)))
+        s.add_clause([-5])
+        sol = s.solve_cubes(processes=2, depth=2)
+        self.assertTrue(evaluate(clauses1, sol) and -5 in sol)
+        self.assertEqual(pycosat.Solver(clauses2).solve_cubes(), "UNSAT")
+        self.assertRaises(ValueError, s.solve_cubes, processes=0)
+        self.assertRaises(ValueError, s.solve_cubes, depth=21)
+
+tests.append(TestSolver)
+
+# -----
+
+class TestEvaluate(unittest.TestCase):
+
+    def test_cnf1(self):
+        self.assertEqual(pycosat.evaluate(clauses1, [1, -2, -3, -4, 5]),
+                         None)
+        self.assertEqual(pycosat.evaluate(clauses1, [1, 2, 3, 4, 5]), 2)
+        self.assertEqual(pycosat.evaluate(clauses1, [-1, -4, 5]), 0)
+        flat = array('i', [1, -5, 4, 0, -1, 5, 3, 4, 0, -3, -4])
+        self.assertEqual(pycosat.evaluate(flat, [3, 4]), 2)
+        self.assertEqual(pycosat.evaluate([[]], []), 0)
+
+    def test_random(self):
+        for i in range(100):
+            cnf = [[random.choice([-1, 1]) * random.randint(1, 8)
+                    for j in range(3)] for k in range(10)]
+            sol = [random.choice([-1, 1]) * v for v in range(1, 9)]
+            k = pycosat.evaluate(cnf, sol)
+            self.assertEqual(k is None, evaluate(cnf, sol))
+            if k is not None:
+                self.assertTrue(evaluate(cnf[:k], sol))
+                self.assertFalse(evaluate(cnf[k:k + 1], sol))
+
+    def test_verify(self):
+        self.assertEqual(solve(clauses1, verify=True), [1, -2, -3, -4, 5])
+        self.assertEqual(solve(clauses2, verify=True), "UNSAT")
+        for blocking in 0, 1:
+            self.assertEqual(len(list(itersolve(clauses1, verify=True,
+                                                blocking=blocking))), 18)
+
+tests.append(TestEvaluate)
+
+# -----
+
+class TestClauseBuffer(unittest.TestCase):
+
+    def test_build(self):
+        cb = pycosat.ClauseBuffer()
+        cb.add([1, -5, 4])
+        cb.extend([array('i', [-1, 5, 3, 4])])
+        cb.add_many(array('i', [-3, -4]))
+        self.assertEqual(len(cb), 3)
+        self.assertEqual((cb.nvars, cb.nlits), (5, 9))
+        self.assertEqual(cb.tolist(), clauses1)
+        self.assertEqual(list(memoryview(cb)),
+                         [1, -5, 4, 0, -1, 5, 3, 4, 0, -3, -4, 0])
+        self.assertRaises(ValueError, cb.extend, [[2], [1, 0]])
+        self.assertRaises(TypeError, cb.add, [1, None])
+        self.assertEqual(cb.tolist(), clauses1)
+
+    def test_exported(self):
+        cb = pycosat.ClauseBuffer(clauses1)
+        m = memoryview(cb)
+        self.assertRaises(BufferError, cb.add, [1])
+        m.release()
+        cb.add([1])
+        self.assertEqual(len(cb), 4)
+
+    def test_solve(self):
+        cb = pycosat.ClauseBuffer(clauses1)
+        self.assertEqual(solve(cb), [1, -2, -3, -4, 5])
+        self.assertEqual(len(list(itersolve(cb))), 18)
+        self.assertEqual(solve(pycosat.ClauseBuffer(clauses2)), "UNSAT")
+        s = pycosat.Solver(cb)
+        s.add_clauses(pycosat.ClauseBuffer([[-1]]))
+        self.assertEqual(s.solve(), [-1, -2, -3, -4, -5])
+        self.assertEqual(pycosat.DDNNF(cb).count(), 18)
+
+tests.append(TestClauseBuffer)
+
+# -----
+
+class TestCNF(unittest.TestCase):
+
+    def test_simplify(self):
+        c = pycosat.CNF([[2, 1], [1, 2, 2], [-1], [3, -3], [4, 1, 5]])
+        self.assertEqual(c.tolist(), [[-1], [2], [4, 5]])
+        self.assertEqual((len(c), c.nvars), (3, 5))
+        self.assertEqual(list(memoryview(c)), [-1, 0, 2, 0, 4, 5, 0])
+        self.assertEqual(pycosat.CNF([[1], [-1, 2], [-2]]).tolist(), [[]])
+        self.assertEqual(pycosat.CNF([]).tolist(), [])
+        # three or more copies of a literal
+        self.assertEqual(pycosat.CNF([[3, 3, 3, 2]]).tolist(), [[2, 3]])
+        c = pycosat.CNF([[1, 1, 1], [-1, 2], [2, 3, 4]])
+        self.assertEqual(c.tolist(), [[1], [2]])
+
+    def test_solve(self):
+        c = pycosat.CNF(clauses1)
+        self.assertEqual(set(tuple(sol) for sol in itersolve(c)),
+                         set(tuple(sol) for sol in itersolve(clauses1)))
+        self.assertEqual(solve(pycosat.CNF(clauses2)), "UNSAT")
+        for lit in range(-5, 6):
+            if lit:
+                self.assertEqual(c.solve([[lit]]) == "UNSAT",
+                                 solve(clauses1 + [[lit]]) == "UNSAT")
+        sol = c.solve(extra=[[-1], [-2]], vars=6)
+        self.assertEqual(sol[:2] + sol[5:], [-1, -2, -6])
+        self.assertTrue(evaluate(clauses1, sol))
+        s = pycosat.Solver(c)
+        s.add_clause([-1])
+        sol = s.solve()
+        self.assertEqual(sol[0], -1)
+        self.assertTrue(evaluate(clauses1, sol))
+
+tests.append(TestCNF)
+
+# -----
+
+class TestCache(unittest.TestCase):
+
+    def test_hits(self):
+        c = pycosat.Cache()
+        sol = solve(clauses1, cache=c)
+        self.assertTrue(evaluate(clauses1, sol))
+        # the same clauses in any order
+        cnf = [list(reversed(clause)) for clause in reversed(clauses1)]
+        self.assertEqual(solve(cnf, cache=c), sol)
+        self.assertEqual(solve(array('i', [-3, -4, 0, 1, -5, 4, 0,
+                                           -1, 5, 3, 4, 0]), cache=c), sol)
+        self.assertEqual(solve(clauses2, cache=c), "UNSAT")
+        self.assertEqual(solve(clauses2, cache=c), "UNSAT")
+        self.assertEqual(len(solve(clauses1, vars=7, cache=c)), 7)
+        stats = c.stats()
+        self.assertEqual((stats['hits'], stats['misses']), (3, 3))
+        self.assertEqual(stats['entries'], len(c))
+        self.assertEqual(len(c), 3)
+        cnf = pycosat.CNF(clauses1)
+        self.assertEqual(cnf.solve(extra=[[-1]], cache=c),
+                         cnf.solve(extra=[[-1]], cache=c))
+        self.assertEqual(c.stats()['hits'], 4)
+        c.clear()
+        self.assertEqual(len(c), 0)
+
+    def test_bound(self):
+        c = pycosat.Cache(maxbytes=500)
+        for i in range(6, 50):
+            solve(clauses1 + [[i]], cache=c)
+        stats = c.stats()
+        self.assertTrue(stats['bytes'] <= 500 and stats['evictions'] > 0)
+        self.assertEqual(stats['entries'] + stats['evictions'], 44)
+        # the most recently used entry is kept
+        solve(clauses1 + [[49]], cache=c)
+        self.assertEqual(c.stats()['hits'], 1)
+
+    def test_wrong_args(self):
+        self.assertRaises(TypeError, solve, clauses1, cache={})
+        self.assertRaises(ValueError, pycosat.Cache, maxbytes=-1)
+
+tests.append(TestCache)
+
+# -----
+
+class TestVarMap(unittest.TestCase):
+
+    def test_intern(self):
+        vm = pycosat.VarMap(['a', 'b'])
+        self.assertEqual(len(vm), 2)
+        self.assertEqual(vm.intern('c'), 3)
+        self.assertEqual(vm.intern_all(['b', 'd', 'a']), [2, 4, 1])
+        self.assertEqual(vm.names(), ['a', 'b', 'c', 'd'])
+        self.assertEqual((vm['c'], vm['~c']), (3, -3))
+        self.assertEqual(vm.name(-4), 'd')
+        self.assertTrue('a' in vm)
+        self.assertFalse('e' in vm)
+        self.assertRaises(KeyError, lambda: vm['e'])
+        self.assertRaises(IndexError, vm.name, 5)
+        self.assertRaises(TypeError, vm.intern, [])
+
+    def test_clauses(self):
+        vm = pycosat.VarMap()
+        cnf = vm.clauses([['x1', '~x5', 'x4'], ('~x1', 'x5', 'x3', 'x4'),
+                          ['~x3', '~x4']])
+        self.assertEqual(cnf, [[1, -2, 3], [-1, 2, 4, 3], [-4, -3]])
+        sols = set(frozenset(vm.solution(sol)) for sol in itersolve(cnf))
+        self.assertEqual(len(sols), 9)
+        self.assertTrue(frozenset(['x1', 'x5']) in sols)
+        vm = pycosat.VarMap(negation='!')
+        self.assertEqual(vm.clauses([['!a', '~a', 'a']]), [[-1, 2, 1]])
+        vm = pycosat.VarMap(negation=None)
+        self.assertEqual(vm.clauses([['~a', ('a', 1)]]), [[1, 2]])
+
+    def test_solver(self):
+        s = pycosat.Solver()
+        s.add_named_clauses([['a', 'b'], ['~a', '~b']])
+        self.assertEqual(s.varmap.names(), ['a', 'b'])
+        self.assertEqual(s.solve_named(['a']), set(['a']))
+        self.assertEqual(s.solve_named(['~a']), set(['b']))
+        self.assertEqual(s.solve_named(['a', 'b']), "UNSAT")
+        s.add_clause([-s.varmap['b']])
+        self.assertEqual(s.solve_named(), set(['a']))
+        vm = pycosat.VarMap(['a'])
+        s = pycosat.Solver([[1]], varmap=vm)
+        self.assertTrue(s.varmap is vm)
+        self.assertEqual(s.solve_named(), set(['a']))
+        self.assertRaises(TypeError, pycosat.Solver, varmap={})
+
+    def test_cycle(self):
+        import gc
+        freed = []
+
+        class Name(object):
+            def __del__(self):
+                freed.append(1)
+
+        name = Name()
+        name.vm = pycosat.VarMap([name])
+        del name
+        gc.collect()
+        self.assertEqual(freed, [1])
+
+    def test_eq_adds_names(self):
+        # a comparison which adds names (and grows the table) while a
+        # name is looked up
+        class Name(object):
+            def __init__(self, vm):
+                self.vm = vm
+            def __hash__(self):
+                return 1
+            def __eq__(self, other):
+                if self.vm is not None:
+                    vm, self.vm = self.vm, None
+                    vm.intern_all(['x%d' % i for i in range(100)])
+                return self is other
+
+        vm = pycosat.VarMap()
+        a = Name(vm)
+        self.assertEqual(vm.intern(a), 1)
+        b = Name(None)
+        self.assertEqual(vm.intern(b), 102)
+        self.assertEqual(vm.intern(a), 1)
+        self.assertEqual(vm.intern(b), 102)
+        self.assertEqual(vm.intern('x50'), 52)
+        self.assertEqual(len(vm), 102)
+
+tests.append(TestVarMap)
+
+# -----
+
+class TestSample(unittest.TestCase):
+
+    def test_wrong_args(self):
+        self.assertRaises(TypeError, pycosat.sample, clauses1)
+        self.assertRaises(ValueError, pycosat.sample, clauses1, -1)
+        self.assertRaises(TypeError, pycosat.sample, clauses1, 1, nosuch=1)
+
+    def test_cnf1(self):
+        sols = pycosat.sample(clauses1, 200, seed=42)
+        self.assertEqual(len(sols), 200)
+        for sol in sols:
+            self.assertTrue(evaluate(clauses1, sol))
+        self.assertTrue(len(set(tuple(sol) for sol in sols)) > 10)
+        self.assertEqual(pycosat.sample(clauses1, 10, seed=1),
+                         pycosat.sample(clauses1, 10, seed=1))
+
+    def test_many_vars(self):
+        # 3^20 solutions, which are too many to be enumerated
+        cnf = [[i, -i - 20] for i in range(1, 21)]
+        sols = pycosat.sample(cnf, 5, seed=3)
+        self.assertEqual(len(set(tuple(sol) for sol in sols)), 5)
+        for sol in sols:
+            self.assertTrue(evaluate(cnf, sol))
+
+    def test_few_solutions(self):
+        self.assertEqual(pycosat.sample(clauses3, 3, vars=3, seed=0)[0][:2],
+                         [-1, -2])
+        self.assertEqual(pycosat.sample(clauses2, 3), "UNSAT")
+        self.assertEqual(pycosat.sample(clauses1, 0), [])
+        self.assertEqual(pycosat.sample(clauses1, 5, prop_limit=2),
+                         "UNKNOWN")
+
+tests.append(TestSample)
+
+# -----
+
+class TestApproxCount(unittest.TestCase):
+
+    def test_wrong_args(self):
+        self.assertRaises(TypeError, pycosat.approx_count)
+        self.assertRaises(ValueError, pycosat.approx_count, clauses1, 0)
+        self.assertRaises(ValueError, pycosat.approx_count, clauses1,
+                          delta=1.0)
+        self.assertRaises(ValueError, pycosat.approx_count, clauses1,
+                          project=[6])
+
+    def test_exact(self):
+        # few solutions are counted exactly
+        self.assertEqual(pycosat.approx_count(clauses1), 18)
+        self.assertEqual(pycosat.approx_count(clauses2), 0)
+        self.assertEqual(pycosat.approx_count(clauses3, vars=3), 2)
+        self.assertEqual(pycosat.approx_count(clauses1, project=[3, 4]), 3)
+        self.assertEqual(pycosat.approx_count(clauses1, prop_limit=2),
+                         "UNKNOWN")
+
+    def test_many_solutions(self):
+        cnf = [[i, -i - 10] for i in range(1, 11)]
+        count = pycosat.approx_count(cnf, epsilon=0.8, delta=0.2, seed=1)
+        self.assertTrue(3 ** 10 / 1.8 <= count <= 3 ** 10 * 1.8)
+        self.assertEqual(pycosat.approx_count(cnf, project=[1, 2, 11, 12]),
+                         9)
+
+tests.append(TestApproxCount)
+
+# -----
+
+class TestDDNNF(unittest.TestCase):
+
+    def test_cnf1(self):
+        d = pycosat.DDNNF(clauses1)
+        ref = set(tuple(sol) for sol in itersolve(clauses1))
+        self.assertEqual(d.count(), 18)
+        self.assertEqual(set(tuple(sol) for sol in d.itersolve()), ref)
+        for lit in range(-5, 6):
+            if lit == 0:
+                continue
+            sols = [sol for sol in ref if lit in sol]
+            self.assertEqual(d.count([lit]), len(sols))
+            self.assertEqual(d.satisfiable([lit]), bool(sols))
+            self.assertEqual(sorted(map(tuple, d.itersolve([lit]))),
+                             sorted(sols))
+        self.assertEqual(d.count([3, 4]), 0)
+        self.assertFalse(d.satisfiable(array('i', [3, 4])))
+        self.assertEqual(list(d.itersolve([1, -1])), [])
+
+    def test_condition(self):
+        d = pycosat.DDNNF(clauses1)
+        c = d.condition([1, -5])
+        self.assertEqual(c.count(), len(list(itersolve(clauses1 +
+                                                       [[1], [-5]]))))
+        self.assertEqual(c.condition([-1]).count(), 0)
+        self.assertEqual(d.count(), 18)
+        for sol in c.itersolve():
+            self.assertTrue(evaluate(clauses1, sol))
+            self.assertEqual((sol[0], sol[4]), (1, -5))
+
+    def test_unsat(self):
+        d = pycosat.DDNNF(clauses2)
+        self.assertEqual(d.count(), 0)
+        self.assertFalse(d.satisfiable())
+        self.assertEqual(list(d.itersolve()), [])
+
+    def test_components(self):
+        # 3^30 solutions of independent components
+        d = pycosat.DDNNF([[i, -i - 30] for i in range(1, 31)], vars=61)
+        self.assertEqual(d.count(), 2 * 3 ** 30)
+        self.assertTrue(d.size() < 200)
+        self.assertEqual(d.count([1, 31, -61]), 3 ** 29)
+
+    def test_wrong_args(self):
+        self.assertRaises(TypeError, pycosat.DDNNF)
+        self.assertRaises(TypeError, pycosat.DDNNF, {})
+        d = pycosat.DDNNF(clauses1)
+        self.assertRaises(ValueError, d.count, [6])
+        self.assertRaises(TypeError, d.condition, 1)
+
+tests.append(TestDDNNF)
+
+class TestSubinterpreter(unittest.TestCase):
+
+    def test_import(self):
+        try:
+            import _xxsubinterpreters as interpreters
+        except ImportError:
+            return
+        for _ in range(3):
+            i = interpreters.create()
+            interpreters.run_string(i, """if True:
+                import sys
+                sys.path[:] = %r
+                import pycosat
+                assert pycosat.solve(%r) == %r
+                assert len(list(pycosat.itersolve(%r))) == 18
+                s = pycosat.Solver(%r)
+                assert s.solve([-1]) == pycosat.solve(%r + [[-1]])
+                """ % ((sys.path, clauses1, [1, -2, -3, -4, 5]) + 3 * (clauses1,)))
+            interpreters.destroy(i)
+        self.assertEqual(pycosat.solve(clauses1), [1, -2, -3, -4, 5])
+
+tests.append(TestSubinterpreter)
+
+# -----
+
+class TestServe(unittest.TestCase):
+
+    def test_client(self):
+        if not hasattr(pycosat, 'serve'):
+            return
+        path = os.path.join(tempfile.mkdtemp(), 'pycosat.sock')
+        t = threading.Thread(target=pycosat.serve,
+                             args=(path, [clauses1, clauses2]),
+                             kwargs={'threads': 2})
+        t.start()
+        while not os.path.exists(path):
+            time.sleep(0.01)
+        c = pycosat.Client(path)
+        self.assertTrue(evaluate(clauses1, c.solve()))
+        self.assertEqual(c.solve(assumptions=[-1]), [-1, -2, -3, -4, -5])
+        sol = c.solve(clauses=[[-1, 7], [-7, -5]], assumptions=[1])
+        self.assertEqual(len(sol), 7)
+        self.assertTrue(evaluate(clauses1 + [[-1, 7], [-7, -5]], sol))
+        self.assertEqual(c.solve(clauses=[[-1, 7], [-7, -5]],
+                                 assumptions=[1, 5]), "UNSAT")
+        self.assertEqual(c.solve(base=1), "UNSAT")
+        self.assertRaises(ValueError, c.solve, base=2)
+        sol = c.solve(clauses=[[-5]], assumptions=[1])
+        self.assertTrue(evaluate(clauses1, sol) and -5 in sol)
+        c.shutdown()
+        t.join()
+        c.close()
+        self.assertRaises(ValueError, c.solve)
+        self.assertFalse(os.path.exists(path))
+        os.rmdir(os.path.dirname(path))
+
+    def test_path(self):
+        if not hasattr(pycosat, 'serve'):
+            return
+        path = os.path.join(tempfile.mkdtemp(), 'pycosat.sock')
+        # a regular file is neither replaced nor removed
+        with open(path, 'w') as fo:
+            fo.write('data')
+        self.assertRaises(OSError, pycosat.serve, path, [clauses1])
+        with open(path) as fi:
+            self.assertEqual(fi.read(), 'data')
+        os.unlink(path)
+        # the socket of a running daemon is not taken over
+        t = threading.Thread(target=pycosat.serve, args=(path, [clauses1]))
+        t.start()
+        while not os.path.exists(path):
+            time.sleep(0.01)
+        self.assertRaises(OSError, pycosat.serve, path, [clauses2])
+        c = pycosat.Client(path)
+        self.assertTrue(evaluate(clauses1, c.solve()))
+        c.shutdown()
+        t.join()
+        c.close()
+        self.assertFalse(os.path.exists(path))
+        os.rmdir(os.path.dirname(path))
+
+    def test_partial(self):
+        if not hasattr(pycosat, 'serve'):
+            return
+        import socket
+        path = os.path.join(tempfile.mkdtemp(), 'pycosat.sock')
+        t = threading.Thread(target=pycosat.serve, args=(path, [clauses1]),
+                             kwargs={'max_lits': 4})
+        t.start()
+        while not os.path.exists(path):
+            time.sleep(0.01)
+        # half a request does not stall the other connections
+        s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        s.connect(path)
+        s.sendall(b'\0' * 10)
+        c = pycosat.Client(path)
+        self.assertTrue(evaluate(clauses1, c.solve()))
+        self.assertEqual(c.solve(assumptions=[-1, -2, -3, -4]),
+                         [-1, -2, -3, -4, -5])
+        # larger requests close the connection
+        d = pycosat.Client(path)
+        self.assertRaises(OSError, d.solve, assumptions=[-1, -2, -3, -4, 5])
+        d.close()
+        self.assertEqual(c.solve(clauses=[[-1]]), [-1, -2, -3, -4, -5])
+        s.close()
+        c.shutdown()
+        t.join()
+        c.close()
+        os.rmdir(os.path.dirname(path))
+
+    def test_unread_reply(self):
+        if not hasattr(pycosat, 'serve'):
+            return
+        import socket
+        import struct
+        path = os.path.join(tempfile.mkdtemp(), 'pycosat.sock')
+        t = threading.Thread(target=pycosat.serve, args=(path, [[[1, 2]]]))
+        t.start()
+        while not os.path.exists(path):
+            time.sleep(0.01)
+        # a large reply, which is never read, does not block the worker
+        s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        s.connect(path)
+        s.sendall(struct.pack('iiiiQi', 0, 0, 1, 0, 0, 300000))
+        c = pycosat.Client(path)
+        self.assertEqual(c.solve(assumptions=[-1]), [-1, 2])
+        c.shutdown()
+        t.join()
+        c.close()
+        s.close()
+        os.rmdir(os.path.dirname(path))
+
+tests.append(TestServe)
+
 # ------------------------------------------------------------------------
 
 def run(verbosity=1, repeat=1):